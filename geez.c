@@ -33,6 +33,14 @@ GEEZDEF void geez_update_target_dimensions(int drawable, int width, int height);
 GEEZDEF Olivec_Canvas geez_get_canvas();
 GEEZDEF void geez_blit();
 
+// Damage tracking
+//
+// Marks a part of the canvas as changed. Once geez_damage() has been called, geez_blit() only sends the damaged
+// parts of the canvas to the server instead of the whole thing and forgets about them afterwards. Code that never
+// calls geez_damage() keeps getting full blits. Resizing the render target always damages the whole canvas.
+GEEZDEF void geez_damage(int x, int y, int w, int h);
+GEEZDEF void geez_damage_all();
+
 #endif
 
 #ifdef GEEZ_IMPLEMENTATION
@@ -40,6 +48,7 @@ GEEZDEF void geez_blit();
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include <dlfcn.h>
@@ -63,6 +72,22 @@ static xcb_connection_t *_connection;
 static xcb_gcontext_t _gcontext;
 static bool _using_shm;
 
+#ifndef GEEZ_MAX_DAMAGE
+#define GEEZ_MAX_DAMAGE 16
+#endif
+
+typedef struct {
+    int x1, y1, x2, y2; // exclusive x2 and y2
+} Damage_Rect;
+
+static Damage_Rect _damage[GEEZ_MAX_DAMAGE];
+static size_t _damage_count;
+static bool _damage_tracking;
+
+// Scratch buffer for packing damaged rects that are narrower than the canvas without SHM
+static uint8_t *_pack_buffer;
+static size_t _pack_capacity;
+
 typedef struct {
     uint32_t size;
     int id;
@@ -215,6 +240,7 @@ GEEZDEF void geez_set_render_target(int drawable, int width, int height) {
             .pixels = (uint32_t*)_current_segment.ptr
         };
     }
+    geez_damage_all();
 }
 
 GEEZDEF void geez_update_target_dimensions(int drawable, int width, int height) {
@@ -236,6 +262,7 @@ GEEZDEF void geez_update_target_dimensions(int drawable, int width, int height)
             .pixels = (uint32_t*)_current_segment.ptr
         };
     }
+    geez_damage_all();
 }
 
 GEEZDEF Olivec_Canvas geez_get_canvas() {
@@ -243,39 +270,151 @@ GEEZDEF Olivec_Canvas geez_get_canvas() {
     return _root_canvas;
 }
 
-GEEZDEF void geez_blit() {
+static
+int64_t damage_area(Damage_Rect r) {
+    return (int64_t)(r.x2 - r.x1)*(r.y2 - r.y1);
+}
+
+static
+Damage_Rect damage_union(Damage_Rect a, Damage_Rect b) {
+    return (Damage_Rect) {
+        .x1 = a.x1 < b.x1 ? a.x1 : b.x1,
+        .y1 = a.y1 < b.y1 ? a.y1 : b.y1,
+        .x2 = a.x2 > b.x2 ? a.x2 : b.x2,
+        .y2 = a.y2 > b.y2 ? a.y2 : b.y2,
+    };
+}
+
+// Merging two rects is worth it when their union does not cover much more than the rects themselves,
+// which also holds for overlapping or touching rects
+static
+bool damage_should_merge(Damage_Rect a, Damage_Rect b) {
+    if (a.x1 <= b.x2 && b.x1 <= a.x2 && a.y1 <= b.y2 && b.y1 <= a.y2) return true;
+    return damage_area(damage_union(a, b)) <= 2*(damage_area(a) + damage_area(b));
+}
+
+static
+void damage_add(Damage_Rect r) {
+    // Merging can make the result overlap other rects, so keep merging until nothing changes
+    for (size_t i = 0; i < _damage_count;) {
+        if (damage_should_merge(_damage[i], r)) {
+            r = damage_union(_damage[i], r);
+            _damage[i] = _damage[--_damage_count];
+            i = 0;
+        } else {
+            i += 1;
+        }
+    }
+
+    if (_damage_count == GEEZ_MAX_DAMAGE) {
+        // Out of slots: merge into the rect that grows the least
+        size_t best = 0;
+        int64_t best_growth = INT64_MAX;
+        for (size_t i = 0; i < _damage_count; ++i) {
+            int64_t growth = damage_area(damage_union(_damage[i], r)) - damage_area(_damage[i]);
+            if (growth < best_growth) {
+                best_growth = growth;
+                best = i;
+            }
+        }
+        r = damage_union(_damage[best], r);
+        _damage[best] = _damage[--_damage_count];
+        damage_add(r);
+        return;
+    }
+
+    _damage[_damage_count++] = r;
+}
+
+GEEZDEF void geez_damage(int x, int y, int w, int h) {
+    _damage_tracking = true;
+
+    Olivec_Normalized_Rect nr = {0};
+    if (!olivec_normalize_rect(x, y, w, h, _root_canvas.width, _root_canvas.height, &nr)) return;
+    damage_add((Damage_Rect) {
+        .x1 = nr.x1,
+        .y1 = nr.y1,
+        .x2 = nr.x2 + 1,
+        .y2 = nr.y2 + 1,
+    });
+}
+
+GEEZDEF void geez_damage_all() {
+    _damage_count = 0;
+    if (_root_canvas.width == 0 || _root_canvas.height == 0) return;
+    _damage[_damage_count++] = (Damage_Rect) {
+        .x1 = 0,
+        .y1 = 0,
+        .x2 = _root_canvas.width,
+        .y2 = _root_canvas.height,
+    };
+}
+
+static
+void blit_rect(Damage_Rect r) {
+    uint16_t w = r.x2 - r.x1;
+    uint16_t h = r.y2 - r.y1;
     if (!_using_shm) {
+        uint8_t *data = (uint8_t*)&OLIVEC_PIXEL(_root_canvas, r.x1, r.y1);
+        if (w != _root_canvas.width) {
+            // Rows of a full width rect are already contiguous, everything else has to be packed
+            size_t size = (size_t)w*h*4;
+            if (size > _pack_capacity) {
+                uint8_t *buffer = realloc(_pack_buffer, size);
+                if (buffer == NULL) {
+                    fprintf(stderr, "ERROR: Could not allocate the blit buffer\n");
+                    return;
+                }
+                _pack_buffer = buffer;
+                _pack_capacity = size;
+            }
+            for (uint16_t y = 0; y < h; ++y) {
+                memcpy(&_pack_buffer[(size_t)y*w*4], &OLIVEC_PIXEL(_root_canvas, r.x1, r.y1 + y), (size_t)w*4);
+            }
+            data = _pack_buffer;
+        }
         xcb_put_image(
             _connection,
             XCB_IMAGE_FORMAT_Z_PIXMAP,
             _drawable,
             _gcontext,
-            _root_canvas.width,
-            _root_canvas.height,
-            0,
-            0,
+            w,
+            h,
+            r.x1,
+            r.y1,
             0,
             _depth,
-            _root_canvas.width * _root_canvas.height * 4, 
-            (uint8_t*)_root_canvas.pixels);
+            (uint32_t)w*h*4,
+            data);
     } else {
         xcb_shm_put_image(
                 _connection,
                 _drawable,
                 _gcontext,
-                _root_canvas.width, 
+                _root_canvas.width,
                 _root_canvas.height,
-                /*src_pos=*/0, 0,
-                _root_canvas.width, 
-                _root_canvas.height,
-                /*dst_pos=*/0, 0,
+                /*src_pos=*/r.x1, r.y1,
+                w,
+                h,
+                /*dst_pos=*/r.x1, r.y1,
                 _depth,
                 XCB_IMAGE_FORMAT_Z_PIXMAP,
                 false,
                 _current_shmseg,
                 /*offfset=*/0);
+    }
+}
+
+GEEZDEF void geez_blit() {
+    if (!_damage_tracking) geez_damage_all();
+
+    for (size_t i = 0; i < _damage_count; ++i) {
+        blit_rect(_damage[i]);
+    }
+    if (_using_shm && _damage_count > 0) {
         begin_wait();
     }
+    _damage_count = 0;
 }
 
 static uint32_t processing_cookie = 0;
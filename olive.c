@@ -34,139 +34,167 @@
 #define OLIVEC_AA_RES 2
 #endif
 
+// Size of the on-stack scratch buffers used to feed per-pixel colors into the span kernels
+#ifndef OLIVEC_SPAN_CHUNK
+#define OLIVEC_SPAN_CHUNK 256
+#endif
+
+// Size of the square blocks the triangle traversal trivially accepts or rejects before testing individual pixels
+#ifndef OLIVEC_TRIANGLE_BLOCK
+#define OLIVEC_TRIANGLE_BLOCK 8
+#endif
+
+// SIMD kernels are only provided for x86 with GCC/Clang style intrinsics and target attributes.
+// Define OLIVEC_NO_SIMD to force the portable scalar code paths.
+#if !defined(OLIVEC_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define OLIVEC_X86_SIMD
+#endif
+
 #define OLIVEC_SWAP(T, a, b) do { T t = a; a = b; b = t; } while (0)
 #define OLIVEC_SIGN(T, x) ((T)((x) > 0) - (T)((x) < 0))
 #define OLIVEC_ABS(T, x) (OLIVEC_SIGN(T, x)*(x))
 
+typedef enum {
+    // One char per cell, non-zero cells are lit
+    OLIVEC_FONT_CELLS = 0,
+    // Every glyph row is packed into (width + 7)/8 bytes, bit x%8 of byte x/8 is the cell in column x
+    OLIVEC_FONT_BITS,
+} Olivec_Font_Format;
+
+// Fonts can be at most 64 cells wide
 typedef struct {
     size_t width, height;
     const char *glyphs;
+    Olivec_Font_Format format;
 } Olivec_Font;
 
 #define OLIVEC_DEFAULT_FONT_HEIGHT 6
 #define OLIVEC_DEFAULT_FONT_WIDTH 6
+// The cells of a glyph row packed into a byte for OLIVEC_FONT_BITS, written out one by one so the table still
+// reads as a picture
+#define OLIVEC_GLYPH_ROW(c0, c1, c2, c3, c4) ((c0) | (c1) << 1 | (c2) << 2 | (c3) << 3 | (c4) << 4)
 // TODO: allocate proper descender and acender areas for the default font
-static char olivec_default_glyphs[128][OLIVEC_DEFAULT_FONT_HEIGHT][OLIVEC_DEFAULT_FONT_WIDTH] = {
+static const uint8_t olivec_default_glyphs[128][OLIVEC_DEFAULT_FONT_HEIGHT] = {
     ['a'] = {
-        {0, 0, 0, 0, 0},
-        {0, 1, 1, 0, 0},
-        {0, 0, 0, 1, 0},
-        {0, 1, 1, 1, 0},
-        {1, 0, 0, 1, 0},
-        {0, 1, 1, 1, 0},
+        OLIVEC_GLYPH_ROW(0, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 1, 0),
     },
     ['b'] = {
-        {1, 0, 0, 0, 0},
-        {1, 1, 1, 0, 0},
-        {1, 0, 0, 1, 0},
-        {1, 0, 0, 1, 0},
-        {1, 0, 0, 1, 0},
-        {1, 1, 1, 0, 0},
+        OLIVEC_GLYPH_ROW(1, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 1, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 1, 1, 0, 0),
     },
     ['c'] = {
-        {0, 0, 0, 0, 0},
-        {0, 1, 1, 0, 0},
-        {1, 0, 0, 1, 0},
-        {1, 0, 0, 0, 0},
-        {1, 0, 0, 1, 0},
-        {0, 1, 1, 0, 0},
+        OLIVEC_GLYPH_ROW(0, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 0, 0),
     },
     ['d'] = {
-        {0, 0, 0, 1, 0},
-        {0, 1, 1, 1, 0},
-        {1, 0, 0, 1, 0},
-        {1, 0, 0, 1, 0},
-        {1, 0, 0, 1, 0},
-        {0, 1, 1, 1, 0},
+        OLIVEC_GLYPH_ROW(0, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 1, 0),
     },
     ['e'] = {
-        {0, 0, 0, 0, 0},
-        {0, 1, 1, 0, 0},
-        {1, 0, 0, 1, 0},
-        {1, 1, 1, 1, 0},
-        {1, 0, 0, 0, 0},
-        {0, 1, 1, 1, 0},
+        OLIVEC_GLYPH_ROW(0, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 1, 1, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 1, 0),
     },
     ['f'] = {
-        {0, 0, 1, 1, 0},
-        {0, 1, 0, 0, 0},
-        {1, 1, 1, 1, 0},
-        {0, 1, 0, 0, 0},
-        {0, 1, 0, 0, 0},
-        {0, 1, 0, 0, 0},
+        OLIVEC_GLYPH_ROW(0, 0, 1, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 1, 1, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 0, 0, 0),
     },
     ['g'] = {0},
     ['h'] = {
-        {1, 0, 0, 0, 0},
-        {1, 1, 1, 0, 0},
-        {1, 0, 0, 1, 0},
-        {1, 0, 0, 1, 0},
-        {1, 0, 0, 1, 0},
-        {1, 0, 0, 1, 0},
+        OLIVEC_GLYPH_ROW(1, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 1, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
     },
     ['i'] = {
-        {0, 0, 1, 0, 0},
-        {0, 0, 0, 0, 0},
-        {0, 0, 1, 0, 0},
-        {0, 0, 1, 0, 0},
-        {0, 0, 1, 0, 0},
-        {0, 0, 1, 0, 0},
+        OLIVEC_GLYPH_ROW(0, 0, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 1, 0, 0),
     },
     ['j'] = {0},
     ['k'] = {
-        {0, 1, 0, 0, 0},
-        {0, 1, 0, 0, 0},
-        {0, 1, 0, 1, 0},
-        {0, 1, 1, 0, 0},
-        {0, 1, 1, 0, 0},
-        {0, 1, 0, 1, 0},
+        OLIVEC_GLYPH_ROW(0, 1, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 0, 1, 0),
     },
     ['l'] = {
-        {0, 1, 1, 0, 0},
-        {0, 0, 1, 0, 0},
-        {0, 0, 1, 0, 0},
-        {0, 0, 1, 0, 0},
-        {0, 0, 1, 0, 0},
-        {0, 1, 1, 1, 0},
+        OLIVEC_GLYPH_ROW(0, 1, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 1, 0),
     },
     ['m'] = {0},
     ['n'] = {0},
     ['o'] = {
-        {0, 0, 0, 0, 0},
-        {0, 1, 1, 0, 0},
-        {1, 0, 0, 1, 0},
-        {1, 0, 0, 1, 0},
-        {1, 0, 0, 1, 0},
-        {0, 1, 1, 0, 0},
+        OLIVEC_GLYPH_ROW(0, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 0, 0),
     },
     ['p'] = {
-        {1, 1, 1, 0, 0},
-        {1, 0, 0, 1, 0},
-        {1, 0, 0, 1, 0},
-        {1, 1, 1, 0, 0},
-        {1, 0, 0, 0, 0},
-        {1, 0, 0, 0, 0},
+        OLIVEC_GLYPH_ROW(1, 1, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 1, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 0, 0),
     },
     ['q'] = {0},
     ['r'] = {
-        {0, 0, 0, 0, 0},
-        {1, 0, 1, 1, 0},
-        {1, 1, 0, 0, 1},
-        {1, 0, 0, 0, 0},
-        {1, 0, 0, 0, 0},
-        {1, 0, 0, 0, 0},
+        OLIVEC_GLYPH_ROW(0, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 1, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 1, 0, 0, 1),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 0, 0),
     },
     ['s'] = {0},
     ['t'] = {0},
     ['u'] = {0},
     ['v'] = {0},
     ['w'] = {
-        {0, 0, 0, 0, 0},
-        {1, 0, 0, 0, 1},
-        {1, 0, 1, 0, 1},
-        {1, 0, 1, 0, 1},
-        {1, 0, 1, 0, 1},
-        {0, 1, 1, 1, 1},
+        OLIVEC_GLYPH_ROW(0, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 0, 1),
+        OLIVEC_GLYPH_ROW(1, 0, 1, 0, 1),
+        OLIVEC_GLYPH_ROW(1, 0, 1, 0, 1),
+        OLIVEC_GLYPH_ROW(1, 0, 1, 0, 1),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 1, 1),
     },
     ['x'] = {0},
     ['y'] = {0},
@@ -200,118 +228,119 @@ static char olivec_default_glyphs[128][OLIVEC_DEFAULT_FONT_HEIGHT][OLIVEC_DEFAUL
     ['Z'] = {0},
 
     ['0'] = {
-        {0, 1, 1, 0, 0},
-        {1, 0, 0, 1, 0},
-        {1, 0, 0, 1, 0},
-        {1, 0, 0, 1, 0},
-        {1, 0, 0, 1, 0},
-        {0, 1, 1, 0, 0},
+        OLIVEC_GLYPH_ROW(0, 1, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 0, 0),
     },
     ['1'] = {
-        {0, 0, 1, 0, 0},
-        {0, 1, 1, 0, 0},
-        {0, 0, 1, 0, 0},
-        {0, 0, 1, 0, 0},
-        {0, 0, 1, 0, 0},
-        {0, 1, 1, 1, 0},
+        OLIVEC_GLYPH_ROW(0, 0, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 1, 0),
     },
     ['2'] = {
-        {0, 1, 1, 0, 0},
-        {1, 0, 0, 1, 0},
-        {0, 0, 0, 1, 0},
-        {0, 1, 1, 0, 0},
-        {1, 0, 0, 0, 0},
-        {1, 1, 1, 1, 0},
+        OLIVEC_GLYPH_ROW(0, 1, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 1, 1, 1, 0),
     },
     ['3'] = {
-        {0, 1, 1, 0, 0},
-        {1, 0, 0, 1, 0},
-        {0, 0, 1, 0, 0},
-        {0, 0, 0, 1, 0},
-        {1, 0, 0, 1, 0},
-        {0, 1, 1, 0, 0},
+        OLIVEC_GLYPH_ROW(0, 1, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 0, 0),
     },
     ['4'] = {
-        {0, 0, 1, 1, 0},
-        {0, 1, 0, 1, 0},
-        {1, 0, 0, 1, 0},
-        {1, 1, 1, 1, 1},
-        {0, 0, 0, 1, 0},
-        {0, 0, 0, 1, 0},
+        OLIVEC_GLYPH_ROW(0, 0, 1, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 1, 1, 1, 1),
+        OLIVEC_GLYPH_ROW(0, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 0, 1, 0),
     },
     ['5'] = {
-        {1, 1, 1, 0, 0},
-        {1, 0, 0, 0, 0},
-        {1, 1, 1, 0, 0},
-        {0, 0, 0, 1, 0},
-        {1, 0, 0, 1, 0},
-        {0, 1, 1, 0, 0},
+        OLIVEC_GLYPH_ROW(1, 1, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 1, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 0, 0),
     },
     ['6'] = {
-        {0, 1, 1, 0, 0},
-        {1, 0, 0, 0, 0},
-        {1, 1, 1, 0, 0},
-        {1, 0, 0, 1, 0},
-        {1, 0, 0, 1, 0},
-        {0, 1, 1, 0, 0},
+        OLIVEC_GLYPH_ROW(0, 1, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 1, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 0, 0),
     },
     ['7'] = {
-        {1, 1, 1, 1, 0},
-        {0, 0, 0, 1, 0},
-        {0, 0, 1, 0, 0},
-        {0, 1, 0, 0, 0},
-        {0, 1, 0, 0, 0},
-        {0, 1, 0, 0, 0},
+        OLIVEC_GLYPH_ROW(1, 1, 1, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 0, 0, 0),
     },
     ['8'] = {
-        {0, 1, 1, 0, 0},
-        {1, 0, 0, 1, 0},
-        {0, 1, 1, 0, 0},
-        {1, 0, 0, 1, 0},
-        {1, 0, 0, 1, 0},
-        {0, 1, 1, 0, 0},
+        OLIVEC_GLYPH_ROW(0, 1, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 0, 0),
 
     },
     ['9'] = {
-        {0, 1, 1, 0, 0},
-        {1, 0, 0, 1, 0},
-        {1, 0, 0, 1, 0},
-        {0, 1, 1, 1, 0},
-        {0, 0, 0, 1, 0},
-        {0, 1, 1, 0, 0},
+        OLIVEC_GLYPH_ROW(0, 1, 1, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(1, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 1, 1, 0, 0),
     },
 
     [','] = {
-        {0, 0, 0, 0, 0},
-        {0, 0, 0, 0, 0},
-        {0, 0, 0, 0, 0},
-        {0, 0, 0, 0, 0},
-        {0, 0, 0, 1, 0},
-        {0, 0, 1, 0, 0},
+        OLIVEC_GLYPH_ROW(0, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 0, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 1, 0, 0),
     },
 
     ['.'] = {
-        {0, 0, 0, 0, 0},
-        {0, 0, 0, 0, 0},
-        {0, 0, 0, 0, 0},
-        {0, 0, 0, 0, 0},
-        {0, 0, 0, 0, 0},
-        {0, 0, 1, 0, 0},
+        OLIVEC_GLYPH_ROW(0, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 1, 0, 0),
     },
     ['-'] = {
-        {0, 0, 0, 0, 0},
-        {0, 0, 0, 0, 0},
-        {0, 0, 0, 0, 0},
-        {1, 1, 1, 1, 0},
-        {0, 0, 0, 0, 0},
-        {0, 0, 0, 0, 0},
+        OLIVEC_GLYPH_ROW(0, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(1, 1, 1, 1, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 0, 0, 0),
+        OLIVEC_GLYPH_ROW(0, 0, 0, 0, 0),
     },
 };
 
 static Olivec_Font olivec_default_font = {
-    .glyphs = &olivec_default_glyphs[0][0][0],
+    .glyphs = (const char*) &olivec_default_glyphs[0][0],
     .width = OLIVEC_DEFAULT_FONT_WIDTH,
     .height = OLIVEC_DEFAULT_FONT_HEIGHT,
+    .format = OLIVEC_FONT_BITS,
 };
 
 typedef struct {
@@ -329,25 +358,403 @@ OLIVECDEF Olivec_Canvas olivec_subcanvas(Olivec_Canvas oc, int x, int y, int w,
 OLIVECDEF bool olivec_in_bounds(Olivec_Canvas oc, int x, int y);
 OLIVECDEF void olivec_blend_color(uint32_t *c1, uint32_t c2);
 OLIVECDEF void olivec_fill(Olivec_Canvas oc, uint32_t color);
+OLIVECDEF void olivec_fill_span(uint32_t *dst, uint32_t color, size_t n);
+// Blend color (or src[i]) over n consecutive pixels at dst. Produces exactly the same result as
+// calling olivec_blend_color() on every pixel, but fully transparent pixels are skipped and fully
+// opaque pixels are stored directly.
+OLIVECDEF void olivec_blend_span(uint32_t *dst, uint32_t color, size_t n);
+OLIVECDEF void olivec_blend_span_pixels(uint32_t *dst, const uint32_t *src, size_t n);
+
+// Blend modes. The Porter-Duff operators compute src*Fa + dst*Fb per channel with the source premultiplied by its
+// alpha on the fly and the canvas taken as premultiplied, which for an opaque canvas is the same as straight alpha.
+// The other modes combine the colors into B(dst, src) and mix B into the destination the way source-over mixes the
+// source, so a transparent source never changes anything. OLIVEC_BLEND_SRC_OVER is exactly olivec_blend_color().
+typedef enum {
+    OLIVEC_BLEND_SRC_OVER = 0,
+    // Porter-Duff
+    OLIVEC_BLEND_CLEAR,    // Fa = 0,        Fb = 0
+    OLIVEC_BLEND_SRC,      // Fa = 1,        Fb = 0
+    OLIVEC_BLEND_DST,      // Fa = 0,        Fb = 1
+    OLIVEC_BLEND_DST_OVER, // Fa = 1 - a_d,  Fb = 1
+    OLIVEC_BLEND_SRC_IN,   // Fa = a_d,      Fb = 0
+    OLIVEC_BLEND_DST_IN,   // Fa = 0,        Fb = a_s
+    OLIVEC_BLEND_SRC_OUT,  // Fa = 1 - a_d,  Fb = 0
+    OLIVEC_BLEND_DST_OUT,  // Fa = 0,        Fb = 1 - a_s
+    OLIVEC_BLEND_SRC_ATOP, // Fa = a_d,      Fb = 1 - a_s
+    OLIVEC_BLEND_DST_ATOP, // Fa = 1 - a_d,  Fb = a_s
+    OLIVEC_BLEND_XOR,      // Fa = 1 - a_d,  Fb = 1 - a_s
+    OLIVEC_BLEND_ADD,      // Fa = 1,        Fb = 1, saturated
+    // B(dst, src)
+    OLIVEC_BLEND_MULTIPLY, // dst*src
+    OLIVEC_BLEND_SCREEN,   // dst + src - dst*src
+    OLIVEC_BLEND_MIN,      // min(dst, src)
+    OLIVEC_BLEND_MAX,      // max(dst, src)
+    OLIVEC_BLEND_COUNT,
+} Olivec_Blend_Mode;
+
+OLIVECDEF void olivec_blend_color_mode(uint32_t *c1, uint32_t c2, Olivec_Blend_Mode mode);
+OLIVECDEF void olivec_blend_span_mode(uint32_t *dst, uint32_t color, size_t n, Olivec_Blend_Mode mode);
+OLIVECDEF void olivec_blend_span_pixels_mode(uint32_t *dst, const uint32_t *src, size_t n, Olivec_Blend_Mode mode);
 OLIVECDEF void olivec_rect(Olivec_Canvas oc, int x, int y, int w, int h, uint32_t color);
+OLIVECDEF void olivec_rect_mode(Olivec_Canvas oc, int x, int y, int w, int h, uint32_t color, Olivec_Blend_Mode mode);
 OLIVECDEF void olivec_frame(Olivec_Canvas oc, int x, int y, int w, int h, size_t thiccness, uint32_t color);
 OLIVECDEF void olivec_circle(Olivec_Canvas oc, int cx, int cy, int r, uint32_t color);
 OLIVECDEF void olivec_ellipse(Olivec_Canvas oc, int cx, int cy, int rx, int ry, uint32_t color);
-// TODO: lines with different thiccness
 OLIVECDEF void olivec_line(Olivec_Canvas oc, int x1, int y1, int x2, int y2, uint32_t color);
+// Anti-aliased line (Xiaolin Wu). Every step along the major axis splits the color between the two nearest pixels.
+OLIVECDEF void olivec_line_aa(Olivec_Canvas oc, int x1, int y1, int x2, int y2, uint32_t color);
+
+typedef enum {
+    OLIVEC_JOIN_MITER = 0,
+    OLIVEC_JOIN_ROUND,
+    OLIVEC_JOIN_BEVEL,
+} Olivec_Join;
+
+typedef enum {
+    OLIVEC_CAP_BUTT = 0,
+    OLIVEC_CAP_ROUND,
+    OLIVEC_CAP_SQUARE,
+} Olivec_Cap;
+
+// Miter joins longer than OLIVEC_MITER_LIMIT half widths fall back to bevel joins
+#ifndef OLIVEC_MITER_LIMIT
+#define OLIVEC_MITER_LIMIT 4
+#endif
+
+// Strokes wider than OLIVEC_STROKE_MAX_THICCNESS pixels are drawn that wide
+#define OLIVEC_STROKE_MAX_THICCNESS (1 << 20)
+
+// Strokes the polyline going through count points stored as x0, y0, x1, y1, ... with a line thiccness pixels wide.
+// The segments, joins and caps are turned into spans first and the spans are merged, so every pixel of the stroke
+// is blended exactly once no matter how much the pieces overlap.
+OLIVECDEF void olivec_stroke(Olivec_Canvas oc, const int *points, size_t count, size_t thiccness, Olivec_Join join, Olivec_Cap cap, uint32_t color);
+// olivec_stroke() with miter joins and butt caps
+OLIVECDEF void olivec_polyline(Olivec_Canvas oc, const int *points, size_t count, size_t thiccness, uint32_t color);
 OLIVECDEF bool olivec_normalize_triangle(size_t width, size_t height, int x1, int y1, int x2, int y2, int x3, int y3, int *lx, int *hx, int *ly, int *hy);
 OLIVECDEF bool olivec_barycentric(int x1, int y1, int x2, int y2, int x3, int y3, int xp, int yp, int *u1, int *u2, int *det);
 OLIVECDEF void olivec_triangle(Olivec_Canvas oc, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t color);
 OLIVECDEF void olivec_triangle3c(Olivec_Canvas oc, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t c1, uint32_t c2, uint32_t c3);
+OLIVECDEF void olivec_triangle_mode(Olivec_Canvas oc, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t color, Olivec_Blend_Mode mode);
+OLIVECDEF void olivec_triangle3c_mode(Olivec_Canvas oc, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t c1, uint32_t c2, uint32_t c3, Olivec_Blend_Mode mode);
 OLIVECDEF void olivec_triangle3z(Olivec_Canvas oc, int x1, int y1, int x2, int y2, int x3, int y3, float z1, float z2, float z3);
 OLIVECDEF void olivec_triangle3uv(Olivec_Canvas oc, int x1, int y1, int x2, int y2, int x3, int y3, float tx1, float ty1, float tx2, float ty2, float tx3, float ty3, float z1, float z2, float z3, Olivec_Canvas texture);
 OLIVECDEF void olivec_triangle3uv_bilinear(Olivec_Canvas oc, int x1, int y1, int x2, int y2, int x3, int y3, float tx1, float ty1, float tx2, float ty2, float tx3, float ty3, float z1, float z2, float z3, Olivec_Canvas texture);
+
+// Mipmapped textures
+//
+// An Olivec_Texture is a canvas together with a chain of smaller versions of it, every level half the size of the
+// previous one down to 1x1. olivec_triangle3uv_mip() compares the area of the triangle in texels with its area in
+// pixels and reads the level whose texels are closest to a pixel, so small and distant triangles sample a small
+// level that stays in cache instead of skipping over the full texture and aliasing. The canvas is level 0 and is
+// not copied, call olivec_texture_update() after changing its pixels.
+//
+// Olivec_Texture texture;
+// if (!olivec_texture_init(&texture, canvas)) return false;
+// olivec_triangle3uv_mip(oc, x1, y1, x2, y2, x3, y3, tx1, ty1, tx2, ty2, tx3, ty3, z1, z2, z3, &texture, OLIVEC_MIP_TRILINEAR);
+// olivec_texture_free(&texture);
+#ifndef OLIVEC_MAX_MIP_LEVELS
+#define OLIVEC_MAX_MIP_LEVELS 16
+#endif
+
+typedef enum {
+    // Nearest texel of the nearest level
+    OLIVEC_MIP_NEAREST = 0,
+    // Bilinear samples of the two nearest levels blended by the fractional level
+    OLIVEC_MIP_TRILINEAR,
+} Olivec_Mip_Filter;
+
+typedef struct {
+    Olivec_Canvas levels[OLIVEC_MAX_MIP_LEVELS];
+    size_t count;
+    uint32_t *pixels; // storage of all the levels after the first one
+} Olivec_Texture;
+
+OLIVECDEF bool olivec_texture_init(Olivec_Texture *texture, Olivec_Canvas canvas);
+OLIVECDEF void olivec_texture_update(Olivec_Texture *texture);
+OLIVECDEF void olivec_texture_free(Olivec_Texture *texture);
+OLIVECDEF void olivec_triangle3uv_mip(Olivec_Canvas oc, int x1, int y1, int x2, int y2, int x3, int y3, float tx1, float ty1, float tx2, float ty2, float tx3, float ty3, float z1, float z2, float z3, const Olivec_Texture *texture, Olivec_Mip_Filter filter);
+
+// Depth buffer
+//
+// z of the triangles is interpolated linearly in screen space, like the reciprocal of the distance to the camera, so
+// bigger z is closer. The _depth variants of the triangles draw a pixel only if its z is greater than the one in the
+// depth buffer and store it there. The test runs before the color of the pixel is computed, so hidden pixels cost a
+// compare and no texture reads. The depth buffer must be at least as large as the canvas.
+//
+// A depth buffer can also keep the range of depths of every OLIVEC_HIZ_SIZE x OLIVEC_HIZ_SIZE tile (hierarchical z).
+// Triangles that are behind the farthest depth of all the tiles they touch are rejected before they are traversed
+// and runs of pixels behind the farthest depth of their tile skip the per pixel test. Drawing only counts the pixels
+// it changes in every tile. The farthest depth of a tile is recomputed when a triangle could be hidden by it, which
+// is never the case for a triangle in front of the closest depth of the tile, and at most once per tile worth of
+// changed pixels. The ranges stay valid as long as the depths are only changed by the _depth triangles and
+// olivec_depth_clear().
+//
+// float depths[WIDTH*HEIGHT];
+// Olivec_Hiz_Tile hiz[OLIVEC_HIZ_COUNT(WIDTH, HEIGHT)];
+// Olivec_Depth db = olivec_depth_hiz(olivec_depth(depths, WIDTH, HEIGHT, WIDTH), hiz);
+// olivec_depth_clear(db);
+// olivec_triangle3uv_depth(oc, db, x1, y1, x2, y2, x3, y3, tx1, ty1, tx2, ty2, tx3, ty3, z1, z2, z3, texture);
+#ifndef OLIVEC_HIZ_SIZE
+#define OLIVEC_HIZ_SIZE 16
+#endif
+
+typedef struct {
+    // No depth of the tile is farther than farthest or closer than closest
+    float farthest, closest;
+    // Pixels changed since farthest was computed
+    uint32_t written;
+} Olivec_Hiz_Tile;
+
+typedef struct {
+    float *depths;
+    size_t width;
+    size_t height;
+    size_t stride;
+    // Tiles row by row, NULL if not kept
+    Olivec_Hiz_Tile *hiz;
+} Olivec_Depth;
+
+#define OLIVEC_DEPTH(db, x, y) (db).depths[(y)*(db).stride + (x)]
+#define OLIVEC_HIZ_COLUMNS(width) (((width) + OLIVEC_HIZ_SIZE - 1)/OLIVEC_HIZ_SIZE)
+#define OLIVEC_HIZ_COUNT(width, height) (OLIVEC_HIZ_COLUMNS(width)*OLIVEC_HIZ_COLUMNS(height))
+
+OLIVECDEF Olivec_Depth olivec_depth(float *depths, size_t width, size_t height, size_t stride);
+// Keeps the depth ranges of the tiles in hiz, which must hold OLIVEC_HIZ_COUNT(db.width, db.height) tiles. Clear the
+// depth buffer afterwards.
+OLIVECDEF Olivec_Depth olivec_depth_hiz(Olivec_Depth db, Olivec_Hiz_Tile *hiz);
+// Sets every depth to 0, which is behind anything with a positive z
+OLIVECDEF void olivec_depth_clear(Olivec_Depth db);
+OLIVECDEF void olivec_triangle_depth(Olivec_Canvas oc, Olivec_Depth db, int x1, int y1, int x2, int y2, int x3, int y3, float z1, float z2, float z3, uint32_t color);
+OLIVECDEF void olivec_triangle3c_depth(Olivec_Canvas oc, Olivec_Depth db, int x1, int y1, int x2, int y2, int x3, int y3, float z1, float z2, float z3, uint32_t c1, uint32_t c2, uint32_t c3);
+OLIVECDEF void olivec_triangle3uv_depth(Olivec_Canvas oc, Olivec_Depth db, int x1, int y1, int x2, int y2, int x3, int y3, float tx1, float ty1, float tx2, float ty2, float tx3, float ty3, float z1, float z2, float z3, Olivec_Canvas texture);
+OLIVECDEF void olivec_triangle3uv_bilinear_depth(Olivec_Canvas oc, Olivec_Depth db, int x1, int y1, int x2, int y2, int x3, int y3, float tx1, float ty1, float tx2, float ty2, float tx3, float ty3, float z1, float z2, float z3, Olivec_Canvas texture);
+OLIVECDEF void olivec_triangle3uv_mip_depth(Olivec_Canvas oc, Olivec_Depth db, int x1, int y1, int x2, int y2, int x3, int y3, float tx1, float ty1, float tx2, float ty2, float tx3, float ty3, float z1, float z2, float z3, const Olivec_Texture *texture, Olivec_Mip_Filter filter);
+
+// Meshes
+//
+// olivec_mesh() draws indexed triangles straight from model space. The positions are multiplied by a 4x4 matrix (row
+// major, applied to the column vector (x, y, z, 1)) into clip space in batches of OLIVEC_MESH_BATCH vertices kept as
+// structure of arrays, so every vertex is transformed once no matter how many triangles share it. Clip space is the
+// OpenGL one: the view volume is -w <= x, y, z <= w with y going up. Triangles outside of the view volume are dropped,
+// the ones crossing the near or the far plane or reaching further than OLIVEC_MESH_GUARD_BAND times the canvas size
+// outside of it are clipped, and backfaces are culled if asked for. The rest is drawn with the triangle functions
+// using z = 1/w, so the depth test works with the depth buffer as is.
+//
+// Textured meshes are drawn with olivec_triangle3uv_mip(). A texture without mipmaps needs no allocation:
+// Olivec_Texture texture = {.levels = {canvas}, .count = 1};
+//
+// Olivec_Mesh mesh = {
+//     .positions = positions, .uvs = uvs, .vertex_count = vertex_count,
+//     .indices = indices, .triangle_count = triangle_count,
+// };
+// Olivec_Mesh_Style style = {.cull = OLIVEC_CULL_BACK, .texture = &texture, .filter = OLIVEC_MIP_NEAREST};
+// Olivec_Mesh_Cache cache = {0};
+// olivec_mesh(oc, &db, &cache, &mesh, mvp, style);
+// olivec_mesh_cache_free(&cache);
+#ifndef OLIVEC_MESH_BATCH
+#define OLIVEC_MESH_BATCH 16
+#endif
+
+#ifndef OLIVEC_MESH_GUARD_BAND
+#define OLIVEC_MESH_GUARD_BAND 2.0f
+#endif
+
+typedef enum {
+    OLIVEC_CULL_NONE = 0,
+    // Drop the triangles whose vertices are clockwise on the screen
+    OLIVEC_CULL_BACK,
+    // Drop the triangles whose vertices are counter-clockwise on the screen
+    OLIVEC_CULL_FRONT,
+} Olivec_Cull;
+
+typedef struct {
+    // x, y, z of every vertex
+    const float *positions;
+    // u, v of every vertex, may be NULL
+    const float *uvs;
+    // Color of every vertex, may be NULL
+    const uint32_t *colors;
+    size_t vertex_count;
+    // Three vertex indices per triangle, triangles with indices out of range are skipped
+    const uint32_t *indices;
+    size_t triangle_count;
+} Olivec_Mesh;
+
+typedef struct {
+    Olivec_Cull cull;
+    // Used when the mesh is drawn neither with the texture nor with the vertex colors
+    uint32_t color;
+    // Used when the mesh has uvs, may be NULL
+    const Olivec_Texture *texture;
+    Olivec_Mip_Filter filter;
+} Olivec_Mesh_Style;
+
+// Post-transform vertices, reused between the calls
+typedef struct {
+    float *vertices;
+    size_t vertices_capacity;
+    uint8_t *outcodes;
+    size_t outcodes_capacity;
+} Olivec_Mesh_Cache;
+
+// db may be NULL. Returns false if the cache could not grow for the vertices of the mesh, nothing is drawn then.
+OLIVECDEF bool olivec_mesh(Olivec_Canvas oc, const Olivec_Depth *db, Olivec_Mesh_Cache *cache, const Olivec_Mesh *mesh, const float mvp[16], Olivec_Mesh_Style style);
+OLIVECDEF void olivec_mesh_cache_free(Olivec_Mesh_Cache *cache);
 OLIVECDEF void olivec_text(Olivec_Canvas oc, const char *text, int x, int y, Olivec_Font font, size_t size, uint32_t color);
+
+// Glyph cache
+//
+// Rasterizes every (font, glyph, size) once into an alpha mask cropped to the lit part of the glyph. The masks do not
+// depend on the color, so the same cache serves text of any color. olivec_text_cached() draws exactly the same
+// pixels as olivec_text() by blending the runs of equal alpha of the masks and skips glyphs that are entirely
+// outside of the canvas before touching them. A cache must not be shared between threads drawing at the same time.
+//
+// Olivec_Glyph_Cache cache = {0};
+// while (running) {
+//     olivec_text_cached(oc, &cache, "FPS: 60", 10, 10, olivec_default_font, 2, color);
+// }
+// olivec_glyph_cache_free(&cache);
+typedef struct {
+    // Key
+    Olivec_Font font;
+    int glyph;
+    size_t size;
+
+    // Bounds of the mask relative to the origin of the glyph. w == 0 for glyphs with nothing to draw.
+    int x, y, w, h;
+    size_t offset; // into the cache's mask storage
+} Olivec_Glyph;
+
+typedef struct {
+    // Open addressing hash table, capacity is a power of two
+    Olivec_Glyph *glyphs;
+    bool *used;
+    size_t count;
+    size_t capacity;
+
+    uint8_t *masks;
+    size_t masks_count;
+    size_t masks_capacity;
+} Olivec_Glyph_Cache;
+
+// Returns NULL only if the glyph could not be rasterized because an allocation failed
+OLIVECDEF const Olivec_Glyph *olivec_glyph_cache_get(Olivec_Glyph_Cache *cache, Olivec_Font font, int glyph, size_t size);
+OLIVECDEF void olivec_glyph_cache_reset(Olivec_Glyph_Cache *cache);
+OLIVECDEF void olivec_glyph_cache_free(Olivec_Glyph_Cache *cache);
+OLIVECDEF void olivec_text_cached(Olivec_Canvas oc, Olivec_Glyph_Cache *cache, const char *text, int x, int y, Olivec_Font font, size_t size, uint32_t color);
+
+// Outline fonts
+//
+// Reads glyph outlines straight out of TrueType (glyf) font data. Nothing is copied, the data only has to outlive the
+// font, so a memory mapped font file works as is. Glyphs are rasterized with exact area coverage into an
+// accumulation buffer, which gives anti-aliased text at any pixel size.
+//
+// Rasterized glyphs are kept in an Olivec_Outline_Cache by (font, codepoint, size). The cache holds at most capacity
+// glyphs and recycles the least recently used one when it is full, so text at many different sizes stays bounded in
+// memory while the glyphs drawn every frame are never rasterized again. A cache must not be shared between threads
+// drawing at the same time.
+//
+// int fd = open("font.ttf", O_RDONLY);
+// struct stat st;
+// fstat(fd, &st);
+// void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+// Olivec_Outline_Font font;
+// if (!olivec_outline_font_init(&font, data, st.st_size)) return false;
+// Olivec_Outline_Cache cache = {.capacity = 512};
+// while (running) {
+//     olivec_text_outline(oc, &cache, "Hello, World", 10, 10, &font, 24, color);
+// }
+// olivec_outline_cache_free(&cache);
+#ifndef OLIVEC_OUTLINE_CACHE_CAPACITY
+#define OLIVEC_OUTLINE_CACHE_CAPACITY 256
+#endif
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+
+    // Offsets of the tables in data
+    uint32_t cmap, glyf, loca, hmtx;
+    // Format of the character map subtable at cmap, 4 or 12
+    int cmap_format;
+    bool long_loca;
+    int glyph_count;
+    int hmetric_count;
+
+    // Metrics in font units, y goes up
+    int units_per_em;
+    int ascent, descent, line_gap;
+    int x_min, y_min, x_max, y_max;
+} Olivec_Outline_Font;
+
+typedef struct {
+    // Key
+    const Olivec_Outline_Font *font;
+    uint32_t codepoint;
+    size_t size;
+
+    int advance; // 16.16 pixels
+    // Bounds of the mask relative to the pen position on the baseline. w == 0 for glyphs with nothing to draw.
+    int x, y, w, h;
+    uint8_t *mask;
+    size_t mask_capacity;
+
+    // Least recently used list
+    int32_t prev, next;
+} Olivec_Outline_Glyph;
+
+typedef struct {
+    size_t capacity; // OLIVEC_OUTLINE_CACHE_CAPACITY if 0
+
+    Olivec_Outline_Glyph *glyphs;
+    size_t count;
+    // Open addressing hash table of indices into glyphs, -1 for empty slots
+    int32_t *slots;
+    size_t slots_capacity;
+    int32_t newest, oldest;
+
+    // Scratch space for rasterization
+    int32_t *points;
+    size_t points_capacity;
+    float *segments;
+    size_t segments_count;
+    size_t segments_capacity;
+    float *accumulator;
+    size_t accumulator_capacity;
+} Olivec_Outline_Cache;
+
+OLIVECDEF bool olivec_outline_font_init(Olivec_Outline_Font *font, const void *data, size_t size);
+// Returns 0 (the missing glyph) for codepoints the font does not cover
+OLIVECDEF int olivec_outline_font_glyph(const Olivec_Outline_Font *font, uint32_t codepoint);
+// size is the size of the em square in pixels. Returns NULL only if an allocation failed. The glyph stays valid
+// until the next call with the same cache.
+OLIVECDEF const Olivec_Outline_Glyph *olivec_outline_cache_get(Olivec_Outline_Cache *cache, const Olivec_Outline_Font *font, uint32_t codepoint, size_t size);
+OLIVECDEF void olivec_outline_cache_reset(Olivec_Outline_Cache *cache);
+OLIVECDEF void olivec_outline_cache_free(Olivec_Outline_Cache *cache);
+// Draws UTF-8 text with the top of the line at y
+OLIVECDEF void olivec_text_outline(Olivec_Canvas oc, Olivec_Outline_Cache *cache, const char *text, int x, int y, const Olivec_Outline_Font *font, size_t size, uint32_t color);
 OLIVECDEF void olivec_sprite_blend(Olivec_Canvas oc, int x, int y, int w, int h, Olivec_Canvas sprite);
+OLIVECDEF void olivec_sprite_blend_mode(Olivec_Canvas oc, int x, int y, int w, int h, Olivec_Canvas sprite, Olivec_Blend_Mode mode);
 OLIVECDEF void olivec_sprite_copy(Olivec_Canvas oc, int x, int y, int w, int h, Olivec_Canvas sprite);
 OLIVECDEF void olivec_sprite_copy_bilinear(Olivec_Canvas oc, int x, int y, int w, int h, Olivec_Canvas sprite);
+// Resamples the whole src canvas into the whole dst canvas with bilinear filtering. The pixel centers of both
+// canvases are aligned and the weights are 8.8 fixed point. Use olivec_subcanvas() to scale into a part of a canvas.
+OLIVECDEF void olivec_scale_bilinear(Olivec_Canvas dst, Olivec_Canvas src);
 OLIVECDEF uint32_t olivec_pixel_bilinear(Olivec_Canvas sprite, int nx, int ny, int w, int h);
 
+typedef enum {
+    OLIVEC_SIMD_NONE = 0,
+    OLIVEC_SIMD_SSE2,
+    OLIVEC_SIMD_AVX2,
+    OLIVEC_SIMD_AVX512, // AVX-512F + AVX-512BW
+} Olivec_Simd_Level;
+
+// The span kernels are picked once at startup based on CPUID. olivec_set_simd_level() allows to lower
+// (but never raise above what the CPU supports) the level afterwards, which is mostly useful for
+// benchmarking and comparing the kernels against each other. Returns the level that is actually in use.
+OLIVECDEF Olivec_Simd_Level olivec_simd_level(void);
+OLIVECDEF Olivec_Simd_Level olivec_set_simd_level(Olivec_Simd_Level level);
+
 typedef struct {
     // Safe ranges to iterate over.
     int x1, x2;
@@ -374,10 +781,274 @@ OLIVECDEF bool olivec_normalize_rect(int x, int y, int w, int h,
                                      size_t canvas_width, size_t canvas_height,
                                      Olivec_Normalized_Rect *nr);
 
+typedef struct {
+    // Bounding box of the triangle clipped to the canvas.
+    int lx, hx, ly, hy;
+
+    // Twice the area of the triangle. Always positive, degenerate triangles are rejected by olivec_triangle_setup().
+    int det;
+
+    // Edge functions e[i](x, y) = a[i]*x + b[i]*y + c[i] oriented so that a pixel is covered when all of them are >= 0.
+    // e[0], e[1] and e[2] are exactly the barycentric weights u1, u2 and u3 of olivec_barycentric() (up to the sign of det).
+    int a[3], b[3], c[3];
+
+    // Traversal state of olivec_triangle_next_span(): the next row and the edge values at (lx, y).
+    int y;
+    int row[3];
+
+    // The rows up to strip_hy are split into OLIVEC_TRIANGLE_BLOCK wide blocks. Only the columns px1..px2 are
+    // touched by non-rejected blocks and fx1..fx2 are the columns of the blocks that are fully covered.
+    int strip_hy;
+    int px1, px2;
+    int fx1, fx2;
+} Olivec_Triangle;
+
+// Sets up the edge functions of a triangle once so the covered pixels can be walked incrementally.
+//
+// Olivec_Triangle t;
+// if (olivec_triangle_setup(&t, oc.width, oc.height, x1, y1, x2, y2, x3, y3)) {
+//     int y, lx, hx, u1, u2;
+//     while (olivec_triangle_next_span(&t, &y, &lx, &hx, &u1, &u2)) {
+//         for (int x = lx; x <= hx; ++x) {
+//             // u1, u2 and t.det - u1 - u2 are the barycentric weights of (x, y)
+//             OLIVEC_PIXEL(oc, x, y) = mix_colors3(c1, c2, c3, u1, u2, t.det);
+//             u1 += t.a[0];
+//             u2 += t.a[1];
+//         }
+//     }
+// }
+OLIVECDEF bool olivec_triangle_setup(Olivec_Triangle *t, size_t width, size_t height, int x1, int y1, int x2, int y2, int x3, int y3);
+OLIVECDEF bool olivec_triangle_next_span(Olivec_Triangle *t, int *y, int *lx, int *hx, int *u1, int *u2);
+
+// Perspective correct texture coordinates of a triangle.
+//
+// z, tx and ty of the vertices are linear in screen space, so they are set up once per triangle as planes and the
+// texture coordinates of a pixel are u = tx/z and v = ty/z. Instead of dividing at every pixel olivec_uv_span()
+// divides at both ends of a run of up to OLIVEC_UV_SUBSPAN pixels and interpolates linearly between them. The error
+// of that grows with how fast z changes along the row, define OLIVEC_UV_SUBSPAN as 1 to divide at every pixel.
+// Runs end at multiples of OLIVEC_UV_SUBSPAN, so a row split between tiles gets the same coordinates as a whole one.
+//
+// Olivec_Uv uv;
+// olivec_uv_setup(&uv, &t, tx1, ty1, tx2, ty2, tx3, ty3, z1, z2, z3);
+// float u[OLIVEC_UV_SUBSPAN], v[OLIVEC_UV_SUBSPAN];
+// while (olivec_triangle_next_span(&t, &y, &lx, &hx, &u1, &u2)) {
+//     for (int x0 = lx, n; x0 <= hx; x0 += n) {
+//         n = olivec_uv_span(&uv, x0, hx, u1, u2, u, v);
+//         u1 += t.a[0]*n;
+//         u2 += t.a[1]*n;
+//         // u[i] and v[i] are the texture coordinates of (x0 + i, y)
+//     }
+// }
+#ifndef OLIVEC_UV_SUBSPAN
+#define OLIVEC_UV_SUBSPAN 16
+#endif
+// The depth test of a run is kept in a 64 bit mask
+#if OLIVEC_UV_SUBSPAN > 64
+#error "OLIVEC_UV_SUBSPAN can be at most 64"
+#endif
+
+typedef struct {
+    // z, tx and ty as c + k1*u1 + k2*u2 of the barycentric weights u1 and u2
+    float c[3], k1[3], k2[3];
+    // Change of z, tx and ty per pixel to the right
+    float dx[3];
+} Olivec_Uv;
+
+OLIVECDEF void olivec_uv_setup(Olivec_Uv *uv, const Olivec_Triangle *t, float tx1, float ty1, float tx2, float ty2, float tx3, float ty3, float z1, float z2, float z3);
+OLIVECDEF int olivec_uv_span(const Olivec_Uv *uv, int x, int hx, int u1, int u2, float *u, float *v);
+
+// Deferred rendering
+//
+// Instead of drawing immediately the olivec_cmd_* functions record the draw calls into an Olivec_CommandList.
+// olivec_tiler_render() then bins the recorded commands into OLIVEC_TILE_SIZE x OLIVEC_TILE_SIZE screen tiles and
+// rasterizes the tiles independently, so the pixels of a tile stay in cache while all of its commands are drawn.
+// With OLIVEC_THREADS defined the tiles are distributed over a pool of worker threads. Either way the result is
+// exactly the same as issuing the same olivec_* calls in the same order directly on the canvas.
+//
+// Olivec_CommandList cl = {0};
+// Olivec_Tiler tiler = {0};
+// while (running) {
+//     olivec_cmd_reset(&cl);
+//     olivec_cmd_fill(&cl, BACKGROUND_COLOR);
+//     olivec_cmd_circle(&cl, x, y, r, color);
+//     olivec_tiler_render(&tiler, oc, &cl);
+// }
+// olivec_tiler_free(&tiler);
+// olivec_cmd_free(&cl);
+
+#ifndef OLIVEC_TILE_SIZE
+#define OLIVEC_TILE_SIZE 64
+#endif
+
+typedef enum {
+    OLIVEC_CMD_FILL = 0,
+    OLIVEC_CMD_RECT,
+    OLIVEC_CMD_FRAME,
+    OLIVEC_CMD_CIRCLE,
+    OLIVEC_CMD_ELLIPSE,
+    OLIVEC_CMD_LINE,
+    OLIVEC_CMD_LINE_AA,
+    OLIVEC_CMD_STROKE,
+    OLIVEC_CMD_TRIANGLE,
+    OLIVEC_CMD_TRIANGLE3C,
+    OLIVEC_CMD_TRIANGLE3Z,
+    OLIVEC_CMD_TRIANGLE3UV,
+    OLIVEC_CMD_TRIANGLE3UV_BILINEAR,
+    OLIVEC_CMD_TRIANGLE3UV_MIP,
+    OLIVEC_CMD_TEXT,
+    OLIVEC_CMD_SPRITE_BLEND,
+    OLIVEC_CMD_SPRITE_COPY,
+    OLIVEC_CMD_SPRITE_COPY_BILINEAR,
+} Olivec_Command_Kind;
+
+typedef struct {
+    Olivec_Command_Kind kind;
+    union {
+        struct { uint32_t color; } fill;
+        struct { int x, y, w, h; uint32_t color; Olivec_Blend_Mode mode; } rect;
+        struct { int x, y, w, h; size_t thiccness; uint32_t color; } frame;
+        struct { int cx, cy, r; uint32_t color; } circle;
+        struct { int cx, cy, rx, ry; uint32_t color; } ellipse;
+        struct { int x1, y1, x2, y2; uint32_t color; } line;
+        struct { size_t offset, count, thiccness; Olivec_Join join; Olivec_Cap cap; uint32_t color; } stroke; // offset into the list's point storage
+        struct { int x1, y1, x2, y2, x3, y3; uint32_t c1, c2, c3; Olivec_Blend_Mode mode; } triangle; // c1 is the color of the flat triangle
+        struct { int x1, y1, x2, y2, x3, y3; float z1, z2, z3; } triangle3z;
+        struct {
+            int x1, y1, x2, y2, x3, y3;
+            float tx1, ty1, tx2, ty2, tx3, ty3;
+            float z1, z2, z3;
+            Olivec_Canvas texture;
+        } triangle3uv;
+        struct {
+            int x1, y1, x2, y2, x3, y3;
+            float tx1, ty1, tx2, ty2, tx3, ty3;
+            float z1, z2, z3;
+            const Olivec_Texture *texture; // must stay alive until the list is drawn
+            Olivec_Mip_Filter filter;
+        } triangle3uv_mip;
+        struct { size_t offset; int x, y; Olivec_Font font; size_t size; uint32_t color; } text; // offset into the list's string storage
+        struct { int x, y, w, h; Olivec_Canvas sprite; Olivec_Blend_Mode mode; } sprite; // mode is only used by SPRITE_BLEND
+    };
+} Olivec_Command;
+
+// Command lists
+//
+// Every command is stored as its kind followed by only the part of the Olivec_Command union that it uses, so small
+// commands like rects take a fraction of sizeof(Olivec_Command). The draw order is a separate array of offsets into
+// that storage, which is what olivec_cmd_sort() and olivec_cmd_merge_rects() rearrange. olivec_cmd_reset() keeps
+// all the memory around, so recording the same amount of commands every frame does not allocate after the first one.
+//
+// A list can be replayed any number of times into any canvas with olivec_cmd_replay() or olivec_tiler_render(),
+// so static scenes only have to be recorded once.
+typedef struct {
+    // Encoded commands
+    uint8_t *data;
+    size_t data_count;
+    size_t data_capacity;
+
+    // Offsets of the commands in data in draw order
+    uint32_t *order;
+    size_t count;
+    size_t order_capacity;
+
+    // Storage for the strings of the text commands
+    char *strings;
+    size_t strings_count;
+    size_t strings_capacity;
+
+    // Storage for the points of the stroke commands
+    int *points;
+    size_t points_count;
+    size_t points_capacity;
+
+    // Scratch space for olivec_cmd_sort()
+    int *boxes;
+    size_t boxes_capacity;
+} Olivec_CommandList;
+
+OLIVECDEF void olivec_cmd_reset(Olivec_CommandList *cl);
+OLIVECDEF void olivec_cmd_free(Olivec_CommandList *cl);
+OLIVECDEF void olivec_cmd_get(const Olivec_CommandList *cl, size_t index, Olivec_Command *c);
+OLIVECDEF void olivec_cmd_replay(const Olivec_CommandList *cl, Olivec_Canvas oc);
+// Groups commands of the same kind, color and texture together so they are drawn back to back. A command is only
+// ever moved past commands it does not overlap with, so the result of drawing the list stays exactly the same.
+OLIVECDEF void olivec_cmd_sort(Olivec_CommandList *cl);
+// Joins consecutive rects of the same color and mode that share an edge into a single rect. Does not change the result.
+OLIVECDEF void olivec_cmd_merge_rects(Olivec_CommandList *cl);
+OLIVECDEF void olivec_cmd_fill(Olivec_CommandList *cl, uint32_t color);
+OLIVECDEF void olivec_cmd_rect(Olivec_CommandList *cl, int x, int y, int w, int h, uint32_t color);
+OLIVECDEF void olivec_cmd_rect_mode(Olivec_CommandList *cl, int x, int y, int w, int h, uint32_t color, Olivec_Blend_Mode mode);
+OLIVECDEF void olivec_cmd_frame(Olivec_CommandList *cl, int x, int y, int w, int h, size_t thiccness, uint32_t color);
+OLIVECDEF void olivec_cmd_circle(Olivec_CommandList *cl, int cx, int cy, int r, uint32_t color);
+OLIVECDEF void olivec_cmd_ellipse(Olivec_CommandList *cl, int cx, int cy, int rx, int ry, uint32_t color);
+OLIVECDEF void olivec_cmd_line(Olivec_CommandList *cl, int x1, int y1, int x2, int y2, uint32_t color);
+OLIVECDEF void olivec_cmd_line_aa(Olivec_CommandList *cl, int x1, int y1, int x2, int y2, uint32_t color);
+OLIVECDEF void olivec_cmd_stroke(Olivec_CommandList *cl, const int *points, size_t count, size_t thiccness, Olivec_Join join, Olivec_Cap cap, uint32_t color);
+OLIVECDEF void olivec_cmd_polyline(Olivec_CommandList *cl, const int *points, size_t count, size_t thiccness, uint32_t color);
+OLIVECDEF void olivec_cmd_triangle(Olivec_CommandList *cl, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t color);
+OLIVECDEF void olivec_cmd_triangle3c(Olivec_CommandList *cl, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t c1, uint32_t c2, uint32_t c3);
+OLIVECDEF void olivec_cmd_triangle_mode(Olivec_CommandList *cl, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t color, Olivec_Blend_Mode mode);
+OLIVECDEF void olivec_cmd_triangle3c_mode(Olivec_CommandList *cl, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t c1, uint32_t c2, uint32_t c3, Olivec_Blend_Mode mode);
+OLIVECDEF void olivec_cmd_triangle3z(Olivec_CommandList *cl, int x1, int y1, int x2, int y2, int x3, int y3, float z1, float z2, float z3);
+OLIVECDEF void olivec_cmd_triangle3uv(Olivec_CommandList *cl, int x1, int y1, int x2, int y2, int x3, int y3, float tx1, float ty1, float tx2, float ty2, float tx3, float ty3, float z1, float z2, float z3, Olivec_Canvas texture);
+OLIVECDEF void olivec_cmd_triangle3uv_bilinear(Olivec_CommandList *cl, int x1, int y1, int x2, int y2, int x3, int y3, float tx1, float ty1, float tx2, float ty2, float tx3, float ty3, float z1, float z2, float z3, Olivec_Canvas texture);
+OLIVECDEF void olivec_cmd_triangle3uv_mip(Olivec_CommandList *cl, int x1, int y1, int x2, int y2, int x3, int y3, float tx1, float ty1, float tx2, float ty2, float tx3, float ty3, float z1, float z2, float z3, const Olivec_Texture *texture, Olivec_Mip_Filter filter);
+OLIVECDEF void olivec_cmd_text(Olivec_CommandList *cl, const char *text, int x, int y, Olivec_Font font, size_t size, uint32_t color);
+OLIVECDEF void olivec_cmd_sprite_blend(Olivec_CommandList *cl, int x, int y, int w, int h, Olivec_Canvas sprite);
+OLIVECDEF void olivec_cmd_sprite_blend_mode(Olivec_CommandList *cl, int x, int y, int w, int h, Olivec_Canvas sprite, Olivec_Blend_Mode mode);
+OLIVECDEF void olivec_cmd_sprite_copy(Olivec_CommandList *cl, int x, int y, int w, int h, Olivec_Canvas sprite);
+OLIVECDEF void olivec_cmd_sprite_copy_bilinear(Olivec_CommandList *cl, int x, int y, int w, int h, Olivec_Canvas sprite);
+
+typedef struct {
+    // Commands of the tile i are items[start[i]..start[i + 1]). All the arrays are reused between frames.
+    uint32_t *start;
+    size_t start_capacity;
+    uint32_t *items;
+    size_t items_capacity;
+    // Tile range touched by every command: x1, y1, x2, y2
+    int *ranges;
+    size_t ranges_capacity;
+
+    // Set up by olivec_tiler_render() for the workers
+    Olivec_Canvas oc;
+    const Olivec_CommandList *cl;
+    size_t tiles_x, tiles_y;
+} Olivec_Tiler;
+
+OLIVECDEF void olivec_tiler_render(Olivec_Tiler *tiler, Olivec_Canvas oc, const Olivec_CommandList *cl);
+OLIVECDEF void olivec_tiler_free(Olivec_Tiler *tiler);
+
+// Parallel for
+//
+// olivec_parallel_for() splits 0..n-1 into chunks of at least grain items and calls func(user, begin, end) for
+// every chunk. With OLIVEC_THREADS defined the chunks run on the worker pool (which is also what the tiled
+// renderer uses), otherwise there is just one chunk that runs on the calling thread. olivec_fill(), the
+// olivec_sprite_* functions and anything else that touches whole canvases are split by rows this way, with
+// each chunk being at least olivec_parallel_grain() pixels big (OLIVEC_PARALLEL_GRAIN by default).
+
+#ifndef OLIVEC_PARALLEL_GRAIN
+#define OLIVEC_PARALLEL_GRAIN (64*1024)
+#endif
+
+typedef void (Olivec_Parallel_Func)(void *user, size_t begin, size_t end);
+
+OLIVECDEF void olivec_parallel_for(size_t n, size_t grain, Olivec_Parallel_Func *func, void *user);
+OLIVECDEF size_t olivec_parallel_grain(void);
+OLIVECDEF void olivec_set_parallel_grain(size_t pixels);
+
+#ifdef OLIVEC_THREADS
+// The worker threads are started lazily by the first parallel job. count is the total amount of threads working
+// on a job including the one that submitted it, 0 means one per online CPU (the default). Must be called before
+// the first job to take effect.
+OLIVECDEF void olivec_threads_init(size_t count);
+#endif // OLIVEC_THREADS
+
 #endif // OLIVE_C_
 
 #ifdef OLIVEC_IMPLEMENTATION
 
+#include <string.h>
+
 OLIVECDEF Olivec_Canvas olivec_canvas(uint32_t *pixels, size_t width, size_t height, size_t stride)
 {
     Olivec_Canvas oc = {
@@ -389,6 +1060,32 @@ OLIVECDEF Olivec_Canvas olivec_canvas(uint32_t *pixels, size_t width, size_t hei
     return oc;
 }
 
+OLIVECDEF Olivec_Depth olivec_depth(float *depths, size_t width, size_t height, size_t stride)
+{
+    Olivec_Depth db = {
+        .depths = depths,
+        .width  = width,
+        .height = height,
+        .stride = stride,
+        .hiz    = NULL,
+    };
+    return db;
+}
+
+OLIVECDEF Olivec_Depth olivec_depth_hiz(Olivec_Depth db, Olivec_Hiz_Tile *hiz)
+{
+    db.hiz = hiz;
+    return db;
+}
+
+OLIVECDEF void olivec_depth_clear(Olivec_Depth db)
+{
+    for (size_t y = 0; y < db.height; ++y) {
+        memset(&OLIVEC_DEPTH(db, 0, y), 0, db.width*sizeof(*db.depths));
+    }
+    if (db.hiz != NULL) memset(db.hiz, 0, OLIVEC_HIZ_COUNT(db.width, db.height)*sizeof(*db.hiz));
+}
+
 OLIVECDEF bool olivec_normalize_rect(int x, int y, int w, int h,
                                      size_t canvas_width, size_t canvas_height,
                                      Olivec_Normalized_Rect *nr)
@@ -444,6 +1141,11 @@ OLIVECDEF Olivec_Canvas olivec_subcanvas(Olivec_Canvas oc, int x, int y, int w,
 #define OLIVEC_ALPHA(color) (((color)&0xFF000000)>>(8*3))
 #define OLIVEC_RGBA(r, g, b, a) ((((r)&0xFF)<<(8*0)) | (((g)&0xFF)<<(8*1)) | (((b)&0xFF)<<(8*2)) | (((a)&0xFF)<<(8*3)))
 
+// Exact x/255 for 0 <= x <= 255*255 without the division. The SIMD kernels do the same thing on 16 bit lanes.
+#define OLIVEC_DIV255(x) (((x) + 1 + ((x) >> 8)) >> 8)
+
+// Source-over. The alpha channel is treated as a regular channel with the source value of 255,
+// which gives a1 + a2*(255 - a1)/255, so an opaque source always produces an opaque pixel.
 OLIVECDEF void olivec_blend_color(uint32_t *c1, uint32_t c2)
 {
     uint32_t r1 = OLIVEC_RED(*c1);
@@ -456,478 +1158,4613 @@ OLIVECDEF void olivec_blend_color(uint32_t *c1, uint32_t c2)
     uint32_t b2 = OLIVEC_BLUE(c2);
     uint32_t a2 = OLIVEC_ALPHA(c2);
 
-    r1 = (r1*(255 - a2) + r2*a2)/255; if (r1 > 255) r1 = 255;
-    g1 = (g1*(255 - a2) + g2*a2)/255; if (g1 > 255) g1 = 255;
-    b1 = (b1*(255 - a2) + b2*a2)/255; if (b1 > 255) b1 = 255;
+    r1 = OLIVEC_DIV255(r1*(255 - a2) + r2*a2);
+    g1 = OLIVEC_DIV255(g1*(255 - a2) + g2*a2);
+    b1 = OLIVEC_DIV255(b1*(255 - a2) + b2*a2);
+    a1 = OLIVEC_DIV255(a1*(255 - a2) + 255*a2);
 
     *c1 = OLIVEC_RGBA(r1, g1, b1, a1);
 }
 
-OLIVECDEF void olivec_fill(Olivec_Canvas oc, uint32_t color)
+// Jobs
+//
+// olivec_pool_run() calls func(user, i) for every i in 0..n-1. With OLIVEC_THREADS the calls are spread over the
+// worker threads and the calling thread, otherwise they are just made in order on the calling thread.
+
+typedef void (Olivec_Job_Func)(void *user, size_t index);
+
+#ifdef OLIVEC_THREADS
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#ifndef OLIVEC_MAX_THREADS
+#define OLIVEC_MAX_THREADS 64
+#endif
+
+static struct {
+    bool started;
+    size_t requested; // 0 means one thread per online CPU
+    size_t count;     // Worker threads, the thread that submitted the job works on it as well
+    pthread_t threads[OLIVEC_MAX_THREADS];
+
+    pthread_mutex_t submit; // Only one job at a time
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    size_t generation;
+    size_t busy;
+
+    Olivec_Job_Func *func;
+    void *user;
+    size_t n;
+    atomic_size_t next;
+} olivec_pool = {
+    .submit = PTHREAD_MUTEX_INITIALIZER,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+static _Thread_local bool olivec_pool_worker = false;
+
+OLIVECDEF void olivec_threads_init(size_t count)
 {
-    for (size_t y = 0; y < oc.height; ++y) {
-        for (size_t x = 0; x < oc.width; ++x) {
-            OLIVEC_PIXEL(oc, x, y) = color;
-        }
-    }
+    pthread_mutex_lock(&olivec_pool.submit);
+    if (!olivec_pool.started) olivec_pool.requested = count;
+    pthread_mutex_unlock(&olivec_pool.submit);
 }
 
-OLIVECDEF void olivec_rect(Olivec_Canvas oc, int x, int y, int w, int h, uint32_t color)
+static void olivec_pool_drain(void)
 {
-    Olivec_Normalized_Rect nr = {0};
-    if (!olivec_normalize_rect(x, y, w, h, oc.width, oc.height, &nr)) return;
-    for (int x = nr.x1; x <= nr.x2; ++x) {
-        for (int y = nr.y1; y <= nr.y2; ++y) {
-            olivec_blend_color(&OLIVEC_PIXEL(oc, x, y), color);
-        }
+    for (;;) {
+        size_t i = atomic_fetch_add(&olivec_pool.next, 1);
+        if (i >= olivec_pool.n) break;
+        olivec_pool.func(olivec_pool.user, i);
     }
 }
 
-OLIVECDEF void olivec_frame(Olivec_Canvas oc, int x, int y, int w, int h, size_t t, uint32_t color)
+static void *olivec_pool_worker_main(void *arg)
 {
-    if (t == 0) return; // Nothing to render
+    (void) arg;
+    olivec_pool_worker = true;
+    size_t seen = 0;
+    pthread_mutex_lock(&olivec_pool.mutex);
+    for (;;) {
+        while (olivec_pool.generation == seen) pthread_cond_wait(&olivec_pool.wake, &olivec_pool.mutex);
+        seen = olivec_pool.generation;
+        pthread_mutex_unlock(&olivec_pool.mutex);
 
-    // Convert the rectangle to 2-points representation
-    int x1 = x;
-    int y1 = y;
-    int x2 = x1 + OLIVEC_SIGN(int, w)*(OLIVEC_ABS(int, w) - 1);
-    if (x1 > x2) OLIVEC_SWAP(int, x1, x2);
-    int y2 = y1 + OLIVEC_SIGN(int, h)*(OLIVEC_ABS(int, h) - 1);
-    if (y1 > y2) OLIVEC_SWAP(int, y1, y2);
+        olivec_pool_drain();
 
-    olivec_rect(oc, x1 - t/2, y1 - t/2, (x2 - x1 + 1) + t/2*2, t, color);  // Top
-    olivec_rect(oc, x1 - t/2, y1 - t/2, t, (y2 - y1 + 1) + t/2*2, color);  // Left
-    olivec_rect(oc, x1 - t/2, y2 + t/2, (x2 - x1 + 1) + t/2*2, -t, color); // Bottom
-    olivec_rect(oc, x2 + t/2, y1 - t/2, -t, (y2 - y1 + 1) + t/2*2, color); // Right
+        pthread_mutex_lock(&olivec_pool.mutex);
+        olivec_pool.busy -= 1;
+        if (olivec_pool.busy == 0) pthread_cond_signal(&olivec_pool.done);
+    }
+    return NULL;
 }
 
-OLIVECDEF void olivec_ellipse(Olivec_Canvas oc, int cx, int cy, int rx, int ry, uint32_t color)
+// Must be called with olivec_pool.submit locked
+static void olivec_pool_start(void)
 {
-    Olivec_Normalized_Rect nr = {0};
-    int rx1 = rx + OLIVEC_SIGN(int, rx);
-    int ry1 = ry + OLIVEC_SIGN(int, ry);
-    if (!olivec_normalize_rect(cx - rx1, cy - ry1, 2*rx1, 2*ry1, oc.width, oc.height, &nr)) return;
-
-    for (int y = nr.y1; y <= nr.y2; ++y) {
-        for (int x = nr.x1; x <= nr.x2; ++x) {
-            float nx = (x + 0.5 - nr.x1)/(2.0f*rx1);
-            float ny = (y + 0.5 - nr.y1)/(2.0f*ry1);
-            float dx = nx - 0.5;
-            float dy = ny - 0.5;
-            if (dx*dx + dy*dy <= 0.5*0.5) {
-                OLIVEC_PIXEL(oc, x, y) = color;
-            }
-        }
+    olivec_pool.started = true;
+    size_t total = olivec_pool.requested;
+    if (total == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        total = cpus > 0 ? (size_t) cpus : 1;
+    }
+    if (total > OLIVEC_MAX_THREADS) total = OLIVEC_MAX_THREADS;
+    for (size_t i = 0; i + 1 < total; ++i) {
+        if (pthread_create(&olivec_pool.threads[olivec_pool.count], NULL, olivec_pool_worker_main, NULL) != 0) break;
+        olivec_pool.count += 1;
     }
 }
 
-OLIVECDEF void olivec_circle(Olivec_Canvas oc, int cx, int cy, int r, uint32_t color)
+static void olivec_pool_run(size_t n, Olivec_Job_Func *func, void *user)
 {
-    Olivec_Normalized_Rect nr = {0};
-    int r1 = r + OLIVEC_SIGN(int, r);
-    if (!olivec_normalize_rect(cx - r1, cy - r1, 2*r1, 2*r1, oc.width, oc.height, &nr)) return;
-
-    for (int y = nr.y1; y <= nr.y2; ++y) {
-        for (int x = nr.x1; x <= nr.x2; ++x) {
-            int count = 0;
-            for (int sox = 0; sox < OLIVEC_AA_RES; ++sox) {
-                for (int soy = 0; soy < OLIVEC_AA_RES; ++soy) {
-                    // TODO: switch to 64 bits to make the overflow less likely
-                    // Also research the probability of overflow
-                    int res1 = (OLIVEC_AA_RES + 1);
-                    int dx = (x*res1*2 + 2 + sox*2 - res1*cx*2 - res1);
-                    int dy = (y*res1*2 + 2 + soy*2 - res1*cy*2 - res1);
-                    if (dx*dx + dy*dy <= res1*res1*r*r*2*2) count += 1;
-                }
-            }
-            uint32_t alpha = ((color&0xFF000000)>>(3*8))*count/OLIVEC_AA_RES/OLIVEC_AA_RES;
-            uint32_t updated_color = (color&0x00FFFFFF)|(alpha<<(3*8));
-            olivec_blend_color(&OLIVEC_PIXEL(oc, x, y), updated_color);
-        }
+    // Jobs submitted from within a job just run on the worker that submitted them
+    if (n <= 1 || olivec_pool_worker) {
+        for (size_t i = 0; i < n; ++i) func(user, i);
+        return;
     }
+
+    pthread_mutex_lock(&olivec_pool.submit);
+    if (!olivec_pool.started) olivec_pool_start();
+
+    pthread_mutex_lock(&olivec_pool.mutex);
+    olivec_pool.func = func;
+    olivec_pool.user = user;
+    olivec_pool.n = n;
+    atomic_store(&olivec_pool.next, 0);
+    olivec_pool.busy = olivec_pool.count;
+    olivec_pool.generation += 1;
+    pthread_cond_broadcast(&olivec_pool.wake);
+    pthread_mutex_unlock(&olivec_pool.mutex);
+
+    olivec_pool_worker = true;
+    olivec_pool_drain();
+    olivec_pool_worker = false;
+
+    pthread_mutex_lock(&olivec_pool.mutex);
+    while (olivec_pool.busy > 0) pthread_cond_wait(&olivec_pool.done, &olivec_pool.mutex);
+    pthread_mutex_unlock(&olivec_pool.mutex);
+    pthread_mutex_unlock(&olivec_pool.submit);
+}
+#else
+static void olivec_pool_run(size_t n, Olivec_Job_Func *func, void *user)
+{
+    for (size_t i = 0; i < n; ++i) func(user, i);
 }
+#endif // OLIVEC_THREADS
 
-OLIVECDEF bool olivec_in_bounds(Olivec_Canvas oc, int x, int y)
+static size_t olivec_grain = OLIVEC_PARALLEL_GRAIN;
+
+OLIVECDEF size_t olivec_parallel_grain(void)
 {
-    return 0 <= x && x < (int) oc.width && 0 <= y && y < (int) oc.height;
+    return olivec_grain;
 }
 
-// TODO: AA for line
-OLIVECDEF void olivec_line(Olivec_Canvas oc, int x1, int y1, int x2, int y2, uint32_t color)
+OLIVECDEF void olivec_set_parallel_grain(size_t pixels)
 {
-    int dx = x2 - x1;
-    int dy = y2 - y1;
+    olivec_grain = pixels > 0 ? pixels : 1;
+}
 
-    // If both of the differences are 0 there will be a division by 0 below.
-    if (dx == 0 && dy == 0) {
-        if (olivec_in_bounds(oc, x1, y1)) {
-            olivec_blend_color(&OLIVEC_PIXEL(oc, x1, y1), color);
-        }
+#ifdef OLIVEC_THREADS
+typedef struct {
+    Olivec_Parallel_Func *func;
+    void *user;
+    size_t n;
+    size_t chunk;
+} Olivec_Parallel_For;
+
+static void olivec_parallel_for_chunk(void *user, size_t index)
+{
+    Olivec_Parallel_For *pf = user;
+    size_t begin = index*pf->chunk;
+    size_t end = begin + pf->chunk;
+    if (end > pf->n) end = pf->n;
+    pf->func(pf->user, begin, end);
+}
+#endif // OLIVEC_THREADS
+
+OLIVECDEF void olivec_parallel_for(size_t n, size_t grain, Olivec_Parallel_Func *func, void *user)
+{
+    if (n == 0) return;
+    if (grain == 0) grain = 1;
+#ifdef OLIVEC_THREADS
+    if (n > grain && !olivec_pool_worker) {
+        Olivec_Parallel_For pf = {func, user, n, grain};
+        olivec_pool_run((n + grain - 1)/grain, olivec_parallel_for_chunk, &pf);
         return;
     }
+#endif
+    func(user, 0, n);
+}
 
-    if (OLIVEC_ABS(int, dx) > OLIVEC_ABS(int, dy)) {
-        if (x1 > x2) {
-            OLIVEC_SWAP(int, x1, x2);
-            OLIVEC_SWAP(int, y1, y2);
-        }
+// Rows per chunk for splitting an operation on rows that are width pixels wide
+static size_t olivec_row_grain(size_t width)
+{
+    if (width == 0) return 1;
+    return (olivec_grain + width - 1)/width;
+}
 
-        for (int x = x1; x <= x2; ++x) {
-            int y = dy*(x - x1)/dx + y1;
-            // TODO: move boundary checks out side of the loops in olivec_draw_line
-            if (olivec_in_bounds(oc, x, y)) {
-                olivec_blend_color(&OLIVEC_PIXEL(oc, x, y), color);
-            }
-        }
-    } else {
-        if (y1 > y2) {
-            OLIVEC_SWAP(int, x1, x2);
-            OLIVEC_SWAP(int, y1, y2);
-        }
+#if defined(__GNUC__)
+#define OLIVEC_ALWAYS_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define OLIVEC_ALWAYS_INLINE __forceinline
+#else
+#define OLIVEC_ALWAYS_INLINE inline
+#endif
 
-        for (int y = y1; y <= y2; ++y) {
-            int x = dx*(y - y1)/dy + x1;
-            // TODO: move boundary checks out side of the loops in olivec_draw_line
-            if (olivec_in_bounds(oc, x, y)) {
-                olivec_blend_color(&OLIVEC_PIXEL(oc, x, y), color);
-            }
+// Span kernels
+//
+// Every kernel has a portable scalar version and, on x86, SSE2/AVX2/AVX-512 versions. The best
+// version supported by the CPU is stored in olivec_kernels once at startup (see olivec_simd_init())
+// and all the primitives call through it on a per span basis.
+
+static void olivec_fill_span_scalar(uint32_t *dst, uint32_t color, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) dst[i] = color;
+}
+
+static void olivec_blend_span_scalar(uint32_t *dst, uint32_t color, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) olivec_blend_color(&dst[i], color);
+}
+
+static bool olivec_edge_scan_scalar(const int e[3], const int a[3], int n, int *first, int *last)
+{
+    int e0 = e[0], e1 = e[1], e2 = e[2];
+    *first = -1;
+    for (int i = 0; i < n; ++i) {
+        if ((e0 | e1 | e2) >= 0) {
+            if (*first < 0) *first = i;
+            *last = i;
+        } else if (*first >= 0) {
+            break;
         }
+        e0 += a[0];
+        e1 += a[1];
+        e2 += a[2];
     }
+    return *first >= 0;
 }
 
-OLIVECDEF uint32_t mix_colors2(uint32_t c1, uint32_t c2, int u1, int det)
+static void olivec_blend_span_pixels_scalar(uint32_t *dst, const uint32_t *src, size_t n)
 {
-    // TODO: estimate how much overflows are an issue in integer only environment
-    int64_t r1 = OLIVEC_RED(c1);
-    int64_t g1 = OLIVEC_GREEN(c1);
-    int64_t b1 = OLIVEC_BLUE(c1);
-    int64_t a1 = OLIVEC_ALPHA(c1);
-
-    int64_t r2 = OLIVEC_RED(c2);
-    int64_t g2 = OLIVEC_GREEN(c2);
-    int64_t b2 = OLIVEC_BLUE(c2);
-    int64_t a2 = OLIVEC_ALPHA(c2);
-
-    if (det != 0) {
-        int u2 = det - u1;
-        int64_t r4 = (r1*u2 + r2*u1)/det;
-        int64_t g4 = (g1*u2 + g2*u1)/det;
-        int64_t b4 = (b1*u2 + b2*u1)/det;
-        int64_t a4 = (a1*u2 + a2*u1)/det;
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t a = OLIVEC_ALPHA(src[i]);
+        if (a == 255) dst[i] = src[i];
+        else if (a != 0) olivec_blend_color(&dst[i], src[i]);
+    }
+}
 
-        return OLIVEC_RGBA(r4, g4, b4, a4);
+// olivec_blend_color_mode() with a constant mode. The alpha channel of the source is taken as 255 like in
+// olivec_blend_color(), which makes the alpha of the result a_s*Fa + a_d*Fb.
+static OLIVEC_ALWAYS_INLINE uint32_t olivec_composite(uint32_t d, uint32_t s, const Olivec_Blend_Mode mode)
+{
+    uint32_t sa = OLIVEC_ALPHA(s);
+    uint32_t da = OLIVEC_ALPHA(d);
+    uint32_t fa, fb;
+    switch (mode) {
+    case OLIVEC_BLEND_CLEAR:     fa = 0;        fb = 0;        break;
+    case OLIVEC_BLEND_SRC:       fa = 255;      fb = 0;        break;
+    case OLIVEC_BLEND_DST:       fa = 0;        fb = 255;      break;
+    case OLIVEC_BLEND_DST_OVER:  fa = 255 - da; fb = 255;      break;
+    case OLIVEC_BLEND_SRC_IN:    fa = da;       fb = 0;        break;
+    case OLIVEC_BLEND_DST_IN:    fa = 0;        fb = sa;       break;
+    case OLIVEC_BLEND_SRC_OUT:   fa = 255 - da; fb = 0;        break;
+    case OLIVEC_BLEND_DST_OUT:   fa = 0;        fb = 255 - sa; break;
+    case OLIVEC_BLEND_SRC_ATOP:  fa = da;       fb = 255 - sa; break;
+    case OLIVEC_BLEND_DST_ATOP:  fa = 255 - da; fb = sa;       break;
+    case OLIVEC_BLEND_XOR:       fa = 255 - da; fb = 255 - sa; break;
+    case OLIVEC_BLEND_ADD:       fa = 255;      fb = 255;      break;
+    default: {
+        uint32_t b = 0;
+        for (int k = 0; k < 24; k += 8) {
+            uint32_t x = (d >> k)&0xFF, y = (s >> k)&0xFF, z;
+            switch (mode) {
+            case OLIVEC_BLEND_MULTIPLY: z = OLIVEC_DIV255(x*y);         break;
+            case OLIVEC_BLEND_SCREEN:   z = x + y - OLIVEC_DIV255(x*y); break;
+            case OLIVEC_BLEND_MIN:      z = x < y ? x : y;              break;
+            case OLIVEC_BLEND_MAX:      z = x > y ? x : y;              break;
+            default:                    z = y;                          break;
+            }
+            b |= z << k;
+        }
+        olivec_blend_color(&d, b | (s&0xFF000000));
+        return d;
+    }
     }
 
-    return 0;
+    // Rounded to the nearest with + 127, which OLIVEC_DIV255 still divides exactly
+    uint32_t a = OLIVEC_DIV255(sa*fa + 127);
+    uint32_t r = 0;
+    for (int k = 0; k < 32; k += 8) {
+        uint32_t x = (d >> k)&0xFF, y = k == 24 ? 255 : (s >> k)&0xFF;
+        uint32_t z = OLIVEC_DIV255(y*a + 127) + OLIVEC_DIV255(x*fb + 127);
+        r |= (z > 255 ? 255 : z) << k;
+    }
+    return r;
 }
 
-OLIVECDEF uint32_t mix_colors3(uint32_t c1, uint32_t c2, uint32_t c3, int u1, int u2, int det)
+// Template of the blend mode kernels: composites color over n pixels at dst, or src[i] if src is not NULL
+static OLIVEC_ALWAYS_INLINE void olivec_mode_span_scalar(uint32_t *dst, const uint32_t *src, uint32_t color, size_t n, const Olivec_Blend_Mode mode)
 {
-    // TODO: estimate how much overflows are an issue in integer only environment
-    int64_t r1 = OLIVEC_RED(c1);
-    int64_t g1 = OLIVEC_GREEN(c1);
-    int64_t b1 = OLIVEC_BLUE(c1);
-    int64_t a1 = OLIVEC_ALPHA(c1);
+    for (size_t i = 0; i < n; ++i) dst[i] = olivec_composite(dst[i], src != NULL ? src[i] : color, mode);
+}
 
-    int64_t r2 = OLIVEC_RED(c2);
-    int64_t g2 = OLIVEC_GREEN(c2);
-    int64_t b2 = OLIVEC_BLUE(c2);
-    int64_t a2 = OLIVEC_ALPHA(c2);
+// Linear interpolation between two colors with the weight f/256 of b, two channels at a time in 16 bit fields
+static inline uint32_t olivec_lerp_color(uint32_t a, uint32_t b, uint32_t f)
+{
+    uint32_t rb = ((a&0x00FF00FF)*(256 - f) + (b&0x00FF00FF)*f + 0x00800080) >> 8;
+    uint32_t ga = (((a >> 8)&0x00FF00FF)*(256 - f) + ((b >> 8)&0x00FF00FF)*f + 0x00800080) >> 8;
+    return (rb&0x00FF00FF) | ((ga&0x00FF00FF) << 8);
+}
 
-    int64_t r3 = OLIVEC_RED(c3);
-    int64_t g3 = OLIVEC_GREEN(c3);
-    int64_t b3 = OLIVEC_BLUE(c3);
-    int64_t a3 = OLIVEC_ALPHA(c3);
+// Bilinear samples between the rows r0 and r1 with the weight fy/256 of r1. The sample k is between the columns
+// columns[k] and columns[k] + 1, weights[k] holds the weight of the right column in the upper 16 bits and the one
+// of the left column in the lower 16 bits. The rows are interpolated first, then the columns.
+static void olivec_bilinear_span_scalar(uint32_t *dst, const uint32_t *r0, const uint32_t *r1, uint32_t fy, const uint32_t *columns, const uint32_t *weights, size_t n)
+{
+    for (size_t k = 0; k < n; ++k) {
+        uint32_t c = columns[k];
+        uint32_t left = olivec_lerp_color(r0[c], r1[c], fy);
+        uint32_t right = olivec_lerp_color(r0[c + 1], r1[c + 1], fy);
+        dst[k] = olivec_lerp_color(left, right, weights[k] >> 16);
+    }
+}
 
-    if (det != 0) {
-        int u3 = det - u1 - u2;
-        int64_t r4 = (r1*u1 + r2*u2 + r3*u3)/det;
-        int64_t g4 = (g1*u1 + g2*u2 + g3*u3)/det;
-        int64_t b4 = (b1*u1 + b2*u2 + b3*u3)/det;
-        int64_t a4 = (a1*u1 + a2*u2 + a3*u3)/det;
+#ifdef OLIVEC_X86_SIMD
+#include <immintrin.h>
 
-        return OLIVEC_RGBA(r4, g4, b4, a4);
+__attribute__((target("sse2")))
+static void olivec_fill_span_sse2(uint32_t *dst, uint32_t color, size_t n)
+{
+    while (n > 0 && ((uintptr_t) dst & 15)) { *dst++ = color; n--; }
+    __m128i v = _mm_set1_epi32((int) color);
+    for (; n >= 16; n -= 16, dst += 16) {
+        _mm_store_si128((__m128i*) dst + 0, v);
+        _mm_store_si128((__m128i*) dst + 1, v);
+        _mm_store_si128((__m128i*) dst + 2, v);
+        _mm_store_si128((__m128i*) dst + 3, v);
     }
+    for (; n >= 4; n -= 4, dst += 4) _mm_store_si128((__m128i*) dst, v);
+    while (n > 0) { *dst++ = color; n--; }
+}
 
-    return 0;
+// The blend kernels unpack the channels into 16 bit lanes and compute
+//   (d*(255 - a) + s*a)/255
+// per channel with OLIVEC_DIV255. The alpha channel of the source is forced to 255 (see olivec_blend_color()).
+#define OLIVEC_ALPHA_MASK 0xFF000000u
+
+__attribute__((target("sse2")))
+static inline __m128i olivec_blend4_sse2(__m128i d, __m128i s, __m128i a, __m128i ia)
+{
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(d, ia), _mm_mullo_epi16(s, a));
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(t, _mm_set1_epi16(1)), _mm_srli_epi16(t, 8)), 8);
 }
 
-// NOTE: we imply u3 = det - u1 - u2
-OLIVECDEF bool olivec_barycentric(int x1, int y1, int x2, int y2, int x3, int y3, int xp, int yp, int *u1, int *u2, int *det)
+__attribute__((target("sse2")))
+static void olivec_blend_span_sse2(uint32_t *dst, uint32_t color, size_t n)
 {
-    *det = ((x1 - x3)*(y2 - y3) - (x2 - x3)*(y1 - y3));
-    *u1  = ((y2 - y3)*(xp - x3) + (x3 - x2)*(yp - y3));
-    *u2  = ((y3 - y1)*(xp - x3) + (x1 - x3)*(yp - y3));
-    int u3 = *det - *u1 - *u2;
-    return (
-               (OLIVEC_SIGN(int, *u1) == OLIVEC_SIGN(int, *det) || *u1 == 0) &&
-               (OLIVEC_SIGN(int, *u2) == OLIVEC_SIGN(int, *det) || *u2 == 0) &&
-               (OLIVEC_SIGN(int, u3) == OLIVEC_SIGN(int, *det) || u3 == 0)
-           );
+    const __m128i zero = _mm_setzero_si128();
+    __m128i s = _mm_unpacklo_epi8(_mm_set1_epi32((int) (color | OLIVEC_ALPHA_MASK)), zero);
+    __m128i a = _mm_set1_epi16((short) OLIVEC_ALPHA(color));
+    __m128i ia = _mm_set1_epi16((short) (255 - OLIVEC_ALPHA(color)));
+    for (; n >= 4; n -= 4, dst += 4) {
+        __m128i d = _mm_loadu_si128((const __m128i*) dst);
+        __m128i lo = olivec_blend4_sse2(_mm_unpacklo_epi8(d, zero), s, a, ia);
+        __m128i hi = olivec_blend4_sse2(_mm_unpackhi_epi8(d, zero), s, a, ia);
+        _mm_storeu_si128((__m128i*) dst, _mm_packus_epi16(lo, hi));
+    }
+    olivec_blend_span_scalar(dst, color, n);
 }
 
-OLIVECDEF bool olivec_normalize_triangle(size_t width, size_t height, int x1, int y1, int x2, int y2, int x3, int y3, int *lx, int *hx, int *ly, int *hy)
+__attribute__((target("sse2")))
+static void olivec_blend_span_pixels_sse2(uint32_t *dst, const uint32_t *src, size_t n)
 {
-    *lx = x1;
-    *hx = x1;
-    if (*lx > x2) *lx = x2;
-    if (*lx > x3) *lx = x3;
-    if (*hx < x2) *hx = x2;
-    if (*hx < x3) *hx = x3;
-    if (*lx < 0) *lx = 0;
-    if ((size_t) *lx >= width) return false;;
-    if (*hx < 0) return false;;
-    if ((size_t) *hx >= width) *hx = width-1;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i amask = _mm_set1_epi32((int) OLIVEC_ALPHA_MASK);
+    const __m128i c255 = _mm_set1_epi16(255);
+    for (; n >= 4; n -= 4, dst += 4, src += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*) src);
+        __m128i sa = _mm_and_si128(s, amask);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(sa, zero)) == 0xFFFF) continue;
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(sa, amask)) == 0xFFFF) {
+            _mm_storeu_si128((__m128i*) dst, s);
+            continue;
+        }
+        __m128i d = _mm_loadu_si128((const __m128i*) dst);
+        __m128i s_lo = _mm_unpacklo_epi8(s, zero);
+        __m128i s_hi = _mm_unpackhi_epi8(s, zero);
+        __m128i a_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_lo, 0xFF), 0xFF);
+        __m128i a_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_hi, 0xFF), 0xFF);
+        s = _mm_or_si128(s, amask);
+        __m128i lo = olivec_blend4_sse2(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero), a_lo, _mm_sub_epi16(c255, a_lo));
+        __m128i hi = olivec_blend4_sse2(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero), a_hi, _mm_sub_epi16(c255, a_hi));
+        _mm_storeu_si128((__m128i*) dst, _mm_packus_epi16(lo, hi));
+    }
+    olivec_blend_span_pixels_scalar(dst, src, n);
+}
 
-    *ly = y1;
-    *hy = y1;
-    if (*ly > y2) *ly = y2;
-    if (*ly > y3) *ly = y3;
-    if (*hy < y2) *hy = y2;
-    if (*hy < y3) *hy = y3;
-    if (*ly < 0) *ly = 0;
-    if ((size_t) *ly >= height) return false;;
-    if (*hy < 0) return false;;
-    if ((size_t) *hy >= height) *hy = height-1;
+__attribute__((target("avx2")))
+static void olivec_fill_span_avx2(uint32_t *dst, uint32_t color, size_t n)
+{
+    while (n > 0 && ((uintptr_t) dst & 31)) { *dst++ = color; n--; }
+    __m256i v = _mm256_set1_epi32((int) color);
+    for (; n >= 32; n -= 32, dst += 32) {
+        _mm256_store_si256((__m256i*) dst + 0, v);
+        _mm256_store_si256((__m256i*) dst + 1, v);
+        _mm256_store_si256((__m256i*) dst + 2, v);
+        _mm256_store_si256((__m256i*) dst + 3, v);
+    }
+    for (; n >= 8; n -= 8, dst += 8) _mm256_store_si256((__m256i*) dst, v);
+    if (n >= 4) { _mm_store_si128((__m128i*) dst, _mm256_castsi256_si128(v)); dst += 4; n -= 4; }
+    while (n > 0) { *dst++ = color; n--; }
+}
 
-    return true;
+__attribute__((target("avx2")))
+static inline __m256i olivec_blend8_avx2(__m256i d, __m256i s, __m256i a, __m256i ia)
+{
+    __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(d, ia), _mm256_mullo_epi16(s, a));
+    return _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(t, _mm256_set1_epi16(1)), _mm256_srli_epi16(t, 8)), 8);
 }
 
-OLIVECDEF void olivec_triangle3c(Olivec_Canvas oc, int x1, int y1, int x2, int y2, int x3, int y3,
-                                 uint32_t c1, uint32_t c2, uint32_t c3)
+__attribute__((target("avx2")))
+static void olivec_blend_span_avx2(uint32_t *dst, uint32_t color, size_t n)
 {
-    int lx, hx, ly, hy;
-    if (olivec_normalize_triangle(oc.width, oc.height, x1, y1, x2, y2, x3, y3, &lx, &hx, &ly, &hy)) {
-        for (int y = ly; y <= hy; ++y) {
-            for (int x = lx; x <= hx; ++x) {
-                int u1, u2, det;
-                if (olivec_barycentric(x1, y1, x2, y2, x3, y3, x, y, &u1, &u2, &det)) {
-                    olivec_blend_color(&OLIVEC_PIXEL(oc, x, y), mix_colors3(c1, c2, c3, u1, u2, det));
-                }
-            }
-        }
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i s = _mm256_unpacklo_epi8(_mm256_set1_epi32((int) (color | OLIVEC_ALPHA_MASK)), zero);
+    __m256i a = _mm256_set1_epi16((short) OLIVEC_ALPHA(color));
+    __m256i ia = _mm256_set1_epi16((short) (255 - OLIVEC_ALPHA(color)));
+    for (; n >= 8; n -= 8, dst += 8) {
+        __m256i d = _mm256_loadu_si256((const __m256i*) dst);
+        __m256i lo = olivec_blend8_avx2(_mm256_unpacklo_epi8(d, zero), s, a, ia);
+        __m256i hi = olivec_blend8_avx2(_mm256_unpackhi_epi8(d, zero), s, a, ia);
+        _mm256_storeu_si256((__m256i*) dst, _mm256_packus_epi16(lo, hi));
     }
+    olivec_blend_span_sse2(dst, color, n);
 }
 
-OLIVECDEF void olivec_triangle3z(Olivec_Canvas oc, int x1, int y1, int x2, int y2, int x3, int y3, float z1, float z2, float z3)
+__attribute__((target("avx2")))
+static void olivec_blend_span_pixels_avx2(uint32_t *dst, const uint32_t *src, size_t n)
 {
-    int lx, hx, ly, hy;
-    if (olivec_normalize_triangle(oc.width, oc.height, x1, y1, x2, y2, x3, y3, &lx, &hx, &ly, &hy)) {
-        for (int y = ly; y <= hy; ++y) {
-            for (int x = lx; x <= hx; ++x) {
-                int u1, u2, det;
-                if (olivec_barycentric(x1, y1, x2, y2, x3, y3, x, y, &u1, &u2, &det)) {
-                    float z = z1*u1/det + z2*u2/det + z3*(det - u1 - u2)/det;
-                    OLIVEC_PIXEL(oc, x, y) = *(uint32_t*)&z;
-                }
-            }
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i amask = _mm256_set1_epi32((int) OLIVEC_ALPHA_MASK);
+    const __m256i c255 = _mm256_set1_epi16(255);
+    for (; n >= 8; n -= 8, dst += 8, src += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i*) src);
+        __m256i sa = _mm256_and_si256(s, amask);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(sa, zero)) == -1) continue;
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(sa, amask)) == -1) {
+            _mm256_storeu_si256((__m256i*) dst, s);
+            continue;
         }
+        __m256i d = _mm256_loadu_si256((const __m256i*) dst);
+        __m256i s_lo = _mm256_unpacklo_epi8(s, zero);
+        __m256i s_hi = _mm256_unpackhi_epi8(s, zero);
+        __m256i a_lo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s_lo, 0xFF), 0xFF);
+        __m256i a_hi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s_hi, 0xFF), 0xFF);
+        s = _mm256_or_si256(s, amask);
+        __m256i lo = olivec_blend8_avx2(_mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi8(s, zero), a_lo, _mm256_sub_epi16(c255, a_lo));
+        __m256i hi = olivec_blend8_avx2(_mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi8(s, zero), a_hi, _mm256_sub_epi16(c255, a_hi));
+        _mm256_storeu_si256((__m256i*) dst, _mm256_packus_epi16(lo, hi));
     }
+    olivec_blend_span_pixels_sse2(dst, src, n);
 }
 
-OLIVECDEF void olivec_triangle3uv(Olivec_Canvas oc, int x1, int y1, int x2, int y2, int x3, int y3, float tx1, float ty1, float tx2, float ty2, float tx3, float ty3, float z1, float z2, float z3, Olivec_Canvas texture)
+__attribute__((target("avx512f")))
+static void olivec_fill_span_avx512(uint32_t *dst, uint32_t color, size_t n)
 {
-    int lx, hx, ly, hy;
-    if (olivec_normalize_triangle(oc.width, oc.height, x1, y1, x2, y2, x3, y3, &lx, &hx, &ly, &hy)) {
-        for (int y = ly; y <= hy; ++y) {
-            for (int x = lx; x <= hx; ++x) {
-                int u1, u2, det;
-                if (olivec_barycentric(x1, y1, x2, y2, x3, y3, x, y, &u1, &u2, &det)) {
-                    int u3 = det - u1 - u2;
-                    float z = z1*u1/det + z2*u2/det + z3*(det - u1 - u2)/det;
-                    float tx = tx1*u1/det + tx2*u2/det + tx3*u3/det;
-                    float ty = ty1*u1/det + ty2*u2/det + ty3*u3/det;
-
-                    int texture_x = tx/z*texture.width;
-                    if (texture_x < 0) texture_x = 0;
-                    if ((size_t) texture_x >= texture.width) texture_x = texture.width - 1;
-
-                    int texture_y = ty/z*texture.height;
-                    if (texture_y < 0) texture_y = 0;
-                    if ((size_t) texture_y >= texture.height) texture_y = texture.height - 1;
-                    OLIVEC_PIXEL(oc, x, y) = OLIVEC_PIXEL(texture, (int)texture_x, (int)texture_y);
-                }
-            }
+    __m512i v = _mm512_set1_epi32((int) color);
+    size_t head = ((64 - ((uintptr_t) dst & 63)) & 63)/4;
+    if (head > n) head = n;
+    _mm512_mask_storeu_epi32(dst, (__mmask16) ((1u << head) - 1), v);
+    dst += head;
+    n -= head;
+    for (; n >= 64; n -= 64, dst += 64) {
+        _mm512_store_si512(dst + 0, v);
+        _mm512_store_si512(dst + 16, v);
+        _mm512_store_si512(dst + 32, v);
+        _mm512_store_si512(dst + 48, v);
+    }
+    for (; n >= 16; n -= 16, dst += 16) _mm512_store_si512(dst, v);
+    _mm512_mask_storeu_epi32(dst, (__mmask16) ((1u << n) - 1), v);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static inline __m512i olivec_blend16_avx512(__m512i d, __m512i s, __m512i a, __m512i ia)
+{
+    __m512i t = _mm512_add_epi16(_mm512_mullo_epi16(d, ia), _mm512_mullo_epi16(s, a));
+    return _mm512_srli_epi16(_mm512_add_epi16(_mm512_add_epi16(t, _mm512_set1_epi16(1)), _mm512_srli_epi16(t, 8)), 8);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void olivec_blend_span_avx512(uint32_t *dst, uint32_t color, size_t n)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i s = _mm512_unpacklo_epi8(_mm512_set1_epi32((int) (color | OLIVEC_ALPHA_MASK)), zero);
+    __m512i a = _mm512_set1_epi16((short) OLIVEC_ALPHA(color));
+    __m512i ia = _mm512_set1_epi16((short) (255 - OLIVEC_ALPHA(color)));
+    while (n > 0) {
+        __mmask16 m = n >= 16 ? 0xFFFF : (__mmask16) ((1u << n) - 1);
+        __m512i d = _mm512_maskz_loadu_epi32(m, dst);
+        __m512i lo = olivec_blend16_avx512(_mm512_unpacklo_epi8(d, zero), s, a, ia);
+        __m512i hi = olivec_blend16_avx512(_mm512_unpackhi_epi8(d, zero), s, a, ia);
+        _mm512_mask_storeu_epi32(dst, m, _mm512_packus_epi16(lo, hi));
+        if (n < 16) break;
+        n -= 16;
+        dst += 16;
+    }
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void olivec_blend_span_pixels_avx512(uint32_t *dst, const uint32_t *src, size_t n)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i amask = _mm512_set1_epi32((int) OLIVEC_ALPHA_MASK);
+    const __m512i c255 = _mm512_set1_epi16(255);
+    while (n > 0) {
+        __mmask16 m = n >= 16 ? 0xFFFF : (__mmask16) ((1u << n) - 1);
+        __m512i s = _mm512_maskz_loadu_epi32(m, src);
+        __m512i sa = _mm512_and_si512(s, amask);
+        // Masked out lanes load as zero, so they count as transparent and never get stored.
+        __mmask16 visible = _mm512_test_epi32_mask(s, amask);
+        __mmask16 opaque = _mm512_cmpeq_epi32_mask(sa, amask);
+        if (visible == 0) {
+            // Nothing to do
+        } else if (opaque == m) {
+            _mm512_mask_storeu_epi32(dst, m, s);
+        } else {
+            __m512i d = _mm512_maskz_loadu_epi32(m, dst);
+            __m512i s_lo = _mm512_unpacklo_epi8(s, zero);
+            __m512i s_hi = _mm512_unpackhi_epi8(s, zero);
+            __m512i a_lo = _mm512_shufflehi_epi16(_mm512_shufflelo_epi16(s_lo, 0xFF), 0xFF);
+            __m512i a_hi = _mm512_shufflehi_epi16(_mm512_shufflelo_epi16(s_hi, 0xFF), 0xFF);
+            s = _mm512_or_si512(s, amask);
+            __m512i lo = olivec_blend16_avx512(_mm512_unpacklo_epi8(d, zero), _mm512_unpacklo_epi8(s, zero), a_lo, _mm512_sub_epi16(c255, a_lo));
+            __m512i hi = olivec_blend16_avx512(_mm512_unpackhi_epi8(d, zero), _mm512_unpackhi_epi8(s, zero), a_hi, _mm512_sub_epi16(c255, a_hi));
+            _mm512_mask_storeu_epi32(dst, visible, _mm512_packus_epi16(lo, hi));
         }
+        if (n < 16) break;
+        n -= 16;
+        dst += 16;
+        src += 16;
     }
 }
 
-OLIVECDEF void olivec_triangle3uv_bilinear(Olivec_Canvas oc, int x1, int y1, int x2, int y2, int x3, int y3, float tx1, float ty1, float tx2, float ty2, float tx3, float ty3, float z1, float z2, float z3, Olivec_Canvas texture)
+// Triangle edge scanning. The three edge values of a run of pixels are evaluated 4/8/16 at a time and a pixel is
+// covered when none of them is negative, which is just the sign bit of e0|e1|e2. Covered pixels of a triangle row
+// are contiguous, so the scan stops at the first uncovered pixel after the covered ones.
+
+__attribute__((target("sse2")))
+static bool olivec_edge_scan_sse2(const int e[3], const int a[3], int n, int *first, int *last)
 {
-    int lx, hx, ly, hy;
-    if (olivec_normalize_triangle(oc.width, oc.height, x1, y1, x2, y2, x3, y3, &lx, &hx, &ly, &hy)) {
-        for (int y = ly; y <= hy; ++y) {
-            for (int x = lx; x <= hx; ++x) {
-                int u1, u2, det;
-                if (olivec_barycentric(x1, y1, x2, y2, x3, y3, x, y, &u1, &u2, &det)) {
-                    int u3 = det - u1 - u2;
-                    float z = z1*u1/det + z2*u2/det + z3*(det - u1 - u2)/det;
-                    float tx = tx1*u1/det + tx2*u2/det + tx3*u3/det;
-                    float ty = ty1*u1/det + ty2*u2/det + ty3*u3/det;
-
-                    float texture_x = tx/z*texture.width;
-                    if (texture_x < 0) texture_x = 0;
-                    if (texture_x >= (float) texture.width) texture_x = texture.width - 1;
-
-                    float texture_y = ty/z*texture.height;
-                    if (texture_y < 0) texture_y = 0;
-                    if (texture_y >= (float) texture.height) texture_y = texture.height - 1;
-
-                    int precision = 100;
-                    OLIVEC_PIXEL(oc, x, y) = olivec_pixel_bilinear(
-                                                 texture,
-                                                 texture_x*precision, texture_y*precision,
-                                                 precision, precision);
-                }
-            }
+    __m128i w0 = _mm_setr_epi32(e[0], e[0] + a[0], e[0] + 2*a[0], e[0] + 3*a[0]);
+    __m128i w1 = _mm_setr_epi32(e[1], e[1] + a[1], e[1] + 2*a[1], e[1] + 3*a[1]);
+    __m128i w2 = _mm_setr_epi32(e[2], e[2] + a[2], e[2] + 2*a[2], e[2] + 3*a[2]);
+    __m128i s0 = _mm_set1_epi32(4*a[0]);
+    __m128i s1 = _mm_set1_epi32(4*a[1]);
+    __m128i s2 = _mm_set1_epi32(4*a[2]);
+    *first = -1;
+    for (int i = 0; i < n; i += 4) {
+        __m128i o = _mm_or_si128(_mm_or_si128(w0, w1), w2);
+        int in = ~_mm_movemask_ps(_mm_castsi128_ps(o)) & 0xF;
+        int lanes = n - i < 4 ? n - i : 4;
+        in &= (1 << lanes) - 1;
+        if (in) {
+            if (*first < 0) *first = i + __builtin_ctz(in);
+            *last = i + 31 - __builtin_clz(in);
         }
+        if (*first >= 0 && *last < i + lanes - 1) break;
+        w0 = _mm_add_epi32(w0, s0);
+        w1 = _mm_add_epi32(w1, s1);
+        w2 = _mm_add_epi32(w2, s2);
     }
+    return *first >= 0;
 }
 
-// TODO: AA for triangle
-OLIVECDEF void olivec_triangle(Olivec_Canvas oc, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t color)
+__attribute__((target("avx2")))
+static bool olivec_edge_scan_avx2(const int e[3], const int a[3], int n, int *first, int *last)
 {
-    int lx, hx, ly, hy;
-    if (olivec_normalize_triangle(oc.width, oc.height, x1, y1, x2, y2, x3, y3, &lx, &hx, &ly, &hy)) {
-        for (int y = ly; y <= hy; ++y) {
-            for (int x = lx; x <= hx; ++x) {
-                int u1, u2, det;
-                if (olivec_barycentric(x1, y1, x2, y2, x3, y3, x, y, &u1, &u2, &det)) {
-                    olivec_blend_color(&OLIVEC_PIXEL(oc, x, y), color);
-                }
-            }
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i w0 = _mm256_add_epi32(_mm256_set1_epi32(e[0]), _mm256_mullo_epi32(lane, _mm256_set1_epi32(a[0])));
+    __m256i w1 = _mm256_add_epi32(_mm256_set1_epi32(e[1]), _mm256_mullo_epi32(lane, _mm256_set1_epi32(a[1])));
+    __m256i w2 = _mm256_add_epi32(_mm256_set1_epi32(e[2]), _mm256_mullo_epi32(lane, _mm256_set1_epi32(a[2])));
+    __m256i s0 = _mm256_set1_epi32(8*a[0]);
+    __m256i s1 = _mm256_set1_epi32(8*a[1]);
+    __m256i s2 = _mm256_set1_epi32(8*a[2]);
+    *first = -1;
+    for (int i = 0; i < n; i += 8) {
+        __m256i o = _mm256_or_si256(_mm256_or_si256(w0, w1), w2);
+        int in = ~_mm256_movemask_ps(_mm256_castsi256_ps(o)) & 0xFF;
+        int lanes = n - i < 8 ? n - i : 8;
+        in &= (1 << lanes) - 1;
+        if (in) {
+            if (*first < 0) *first = i + __builtin_ctz(in);
+            *last = i + 31 - __builtin_clz(in);
         }
+        if (*first >= 0 && *last < i + lanes - 1) break;
+        w0 = _mm256_add_epi32(w0, s0);
+        w1 = _mm256_add_epi32(w1, s1);
+        w2 = _mm256_add_epi32(w2, s2);
     }
+    return *first >= 0;
 }
 
-OLIVECDEF void olivec_text(Olivec_Canvas oc, const char *text, int tx, int ty, Olivec_Font font, size_t glyph_size, uint32_t color)
+__attribute__((target("avx512f")))
+static bool olivec_edge_scan_avx512(const int e[3], const int a[3], int n, int *first, int *last)
 {
-    for (size_t i = 0; *text; ++i, ++text) {
-        int gx = tx + i*font.width*glyph_size;
-        int gy = ty;
-        const char *glyph = &font.glyphs[(*text)*sizeof(char)*font.width*font.height];
-        for (int dy = 0; (size_t) dy < font.height; ++dy) {
-            for (int dx = 0; (size_t) dx < font.width; ++dx) {
-                int px = gx + dx*glyph_size;
-                int py = gy + dy*glyph_size;
-                if (0 <= px && px < (int) oc.width && 0 <= py && py < (int) oc.height) {
-                    if (glyph[dy*font.width + dx]) {
-                        olivec_rect(oc, px, py, glyph_size, glyph_size, color);
-                    }
-                }
-            }
+    const __m512i lane = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m512i w0 = _mm512_add_epi32(_mm512_set1_epi32(e[0]), _mm512_mullo_epi32(lane, _mm512_set1_epi32(a[0])));
+    __m512i w1 = _mm512_add_epi32(_mm512_set1_epi32(e[1]), _mm512_mullo_epi32(lane, _mm512_set1_epi32(a[1])));
+    __m512i w2 = _mm512_add_epi32(_mm512_set1_epi32(e[2]), _mm512_mullo_epi32(lane, _mm512_set1_epi32(a[2])));
+    __m512i s0 = _mm512_set1_epi32(16*a[0]);
+    __m512i s1 = _mm512_set1_epi32(16*a[1]);
+    __m512i s2 = _mm512_set1_epi32(16*a[2]);
+    *first = -1;
+    for (int i = 0; i < n; i += 16) {
+        __m512i o = _mm512_or_si512(_mm512_or_si512(w0, w1), w2);
+        int lanes = n - i < 16 ? n - i : 16;
+        int in = _mm512_mask_cmpge_epi32_mask((__mmask16) ((1u << lanes) - 1), o, _mm512_setzero_si512());
+        if (in) {
+            if (*first < 0) *first = i + __builtin_ctz(in);
+            *last = i + 31 - __builtin_clz(in);
         }
+        if (*first >= 0 && *last < i + lanes - 1) break;
+        w0 = _mm512_add_epi32(w0, s0);
+        w1 = _mm512_add_epi32(w1, s1);
+        w2 = _mm512_add_epi32(w2, s2);
     }
+    return *first >= 0;
+}
+// Bilinear sampling. Every sample needs two neighbouring pixels from each row, which are fetched with one 64 bit load
+// per row, so there is nothing to gain from wider vectors. The left and right pixels are interleaved channel by
+// channel, which turns the column interpolation into a single multiply-add with the packed weights. Two samples
+// are done at a time and the rounding is the same as in olivec_bilinear_span_scalar().
+__attribute__((target("sse2")))
+static inline __m128i olivec_lerp8_sse2(__m128i a, __m128i b, __m128i wa, __m128i wb)
+{
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(a, wa), _mm_mullo_epi16(b, wb));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_set1_epi16(128)), 8);
 }
 
-OLIVECDEF void olivec_sprite_blend(Olivec_Canvas oc, int x, int y, int w, int h, Olivec_Canvas sprite)
+__attribute__((target("sse2")))
+static void olivec_bilinear_span_sse2(uint32_t *dst, const uint32_t *r0, const uint32_t *r1, uint32_t fy, const uint32_t *columns, const uint32_t *weights, size_t n)
 {
-    if (sprite.width == 0) return;
-    if (sprite.height == 0) return;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i w0 = _mm_set1_epi16((short) (256 - fy));
+    const __m128i w1 = _mm_set1_epi16((short) fy);
+    const __m128i half = _mm_set1_epi32(128);
+    for (; n >= 2; n -= 2, dst += 2, columns += 2, weights += 2) {
+        // [left0, right0, left1, right1] -> [left0, left1, right0, right1] -> bytes of left and right interleaved
+        __m128i a = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*) &r0[columns[0]]), _mm_loadl_epi64((const __m128i*) &r0[columns[1]]));
+        __m128i b = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*) &r1[columns[0]]), _mm_loadl_epi64((const __m128i*) &r1[columns[1]]));
+        a = _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0));
+        b = _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0));
+        a = _mm_unpacklo_epi8(a, _mm_srli_si128(a, 8));
+        b = _mm_unpacklo_epi8(b, _mm_srli_si128(b, 8));
 
-    Olivec_Normalized_Rect nr = {0};
-    if (!olivec_normalize_rect(x, y, w, h, oc.width, oc.height, &nr)) return;
+        __m128i lo = olivec_lerp8_sse2(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), w0, w1);
+        __m128i hi = olivec_lerp8_sse2(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), w0, w1);
+        lo = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(lo, _mm_set1_epi32((int) weights[0])), half), 8);
+        hi = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(hi, _mm_set1_epi32((int) weights[1])), half), 8);
+        __m128i p = _mm_packs_epi32(lo, hi);
+        _mm_storel_epi64((__m128i*) dst, _mm_packus_epi16(p, p));
+    }
+    olivec_bilinear_span_scalar(dst, r0, r1, fy, columns, weights, n);
+}
 
-    int xa = nr.ox1;
-    if (w < 0) xa = nr.ox2;
-    int ya = nr.oy1;
-    if (h < 0) ya = nr.oy2;
-    for (int y = nr.y1; y <= nr.y2; ++y) {
-        for (int x = nr.x1; x <= nr.x2; ++x) {
-            size_t nx = (x - xa)*((int) sprite.width)/w;
-            size_t ny = (y - ya)*((int) sprite.height)/h;
-            olivec_blend_color(&OLIVEC_PIXEL(oc, x, y), OLIVEC_PIXEL(sprite, nx, ny));
+// Blend modes on 16 bit lanes, two pixels per __m128i, with exactly the same rounding as olivec_composite(). The
+// Porter-Duff operators share one multiply-add of the per pixel factors, the other modes compute B(dst, src) and
+// reuse the source-over kernel to mix it in.
+__attribute__((target("sse2")))
+static inline __m128i olivec_div255_sse2(__m128i x)
+{
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)), _mm_srli_epi16(x, 8)), 8);
+}
+
+__attribute__((target("sse2")))
+static OLIVEC_ALWAYS_INLINE __m128i olivec_composite2_sse2(__m128i d, __m128i s, const Olivec_Blend_Mode mode)
+{
+    const __m128i c255 = _mm_set1_epi16(255);
+    const __m128i alpha = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sa = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xFF), 0xFF);
+    __m128i da = _mm_shufflehi_epi16(_mm_shufflelo_epi16(d, 0xFF), 0xFF);
+    s = _mm_or_si128(s, alpha);
+    __m128i fa, fb;
+    switch (mode) {
+    case OLIVEC_BLEND_CLEAR:     fa = zero;                       fb = zero;                       break;
+    case OLIVEC_BLEND_SRC:       fa = c255;                       fb = zero;                       break;
+    case OLIVEC_BLEND_DST:       fa = zero;                       fb = c255;                       break;
+    case OLIVEC_BLEND_DST_OVER:  fa = _mm_sub_epi16(c255, da);    fb = c255;                       break;
+    case OLIVEC_BLEND_SRC_IN:    fa = da;                         fb = zero;                       break;
+    case OLIVEC_BLEND_DST_IN:    fa = zero;                       fb = sa;                         break;
+    case OLIVEC_BLEND_SRC_OUT:   fa = _mm_sub_epi16(c255, da);    fb = zero;                       break;
+    case OLIVEC_BLEND_DST_OUT:   fa = zero;                       fb = _mm_sub_epi16(c255, sa);    break;
+    case OLIVEC_BLEND_SRC_ATOP:  fa = da;                         fb = _mm_sub_epi16(c255, sa);    break;
+    case OLIVEC_BLEND_DST_ATOP:  fa = _mm_sub_epi16(c255, da);    fb = sa;                         break;
+    case OLIVEC_BLEND_XOR:       fa = _mm_sub_epi16(c255, da);    fb = _mm_sub_epi16(c255, sa);    break;
+    case OLIVEC_BLEND_ADD:       fa = c255;                       fb = c255;                       break;
+    default: {
+        __m128i b;
+        switch (mode) {
+        case OLIVEC_BLEND_MULTIPLY: b = olivec_div255_sse2(_mm_mullo_epi16(d, s)); break;
+        case OLIVEC_BLEND_SCREEN:   b = _mm_sub_epi16(_mm_add_epi16(d, s), olivec_div255_sse2(_mm_mullo_epi16(d, s))); break;
+        case OLIVEC_BLEND_MIN:      b = _mm_min_epi16(d, s); break;
+        case OLIVEC_BLEND_MAX:      b = _mm_max_epi16(d, s); break;
+        default:                    b = s; break;
         }
+        return olivec_blend4_sse2(d, _mm_or_si128(b, alpha), sa, _mm_sub_epi16(c255, sa));
     }
+    }
+
+    const __m128i half = _mm_set1_epi16(127);
+    __m128i a = olivec_div255_sse2(_mm_add_epi16(_mm_mullo_epi16(sa, fa), half));
+    // Up to 510, the saturation is left to the final pack
+    return _mm_add_epi16(olivec_div255_sse2(_mm_add_epi16(_mm_mullo_epi16(s, a), half)),
+                         olivec_div255_sse2(_mm_add_epi16(_mm_mullo_epi16(d, fb), half)));
 }
 
-OLIVECDEF void olivec_sprite_copy(Olivec_Canvas oc, int x, int y, int w, int h, Olivec_Canvas sprite)
+__attribute__((target("sse2")))
+static OLIVEC_ALWAYS_INLINE void olivec_mode_span_sse2(uint32_t *dst, const uint32_t *src, uint32_t color, size_t n, const Olivec_Blend_Mode mode)
 {
-    if (sprite.width == 0) return;
-    if (sprite.height == 0) return;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i c = _mm_set1_epi32((int) color);
+    for (; n >= 4; n -= 4, dst += 4) {
+        __m128i s = c;
+        if (src != NULL) {
+            s = _mm_loadu_si128((const __m128i*) src);
+            src += 4;
+        }
+        __m128i d = _mm_loadu_si128((const __m128i*) dst);
+        __m128i lo = olivec_composite2_sse2(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero), mode);
+        __m128i hi = olivec_composite2_sse2(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero), mode);
+        _mm_storeu_si128((__m128i*) dst, _mm_packus_epi16(lo, hi));
+    }
+    olivec_mode_span_scalar(dst, src, color, n, mode);
+}
 
-    // TODO: consider introducing flip parameter instead of relying on negative width and height
-    // Similar to how SDL_RenderCopyEx does that
-    Olivec_Normalized_Rect nr = {0};
-    if (!olivec_normalize_rect(x, y, w, h, oc.width, oc.height, &nr)) return;
+__attribute__((target("avx2")))
+static inline __m256i olivec_div255_avx2(__m256i x)
+{
+    return _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(x, _mm256_set1_epi16(1)), _mm256_srli_epi16(x, 8)), 8);
+}
 
-    int xa = nr.ox1;
-    if (w < 0) xa = nr.ox2;
-    int ya = nr.oy1;
-    if (h < 0) ya = nr.oy2;
-    for (int y = nr.y1; y <= nr.y2; ++y) {
-        for (int x = nr.x1; x <= nr.x2; ++x) {
-            size_t nx = (x - xa)*((int) sprite.width)/w;
-            size_t ny = (y - ya)*((int) sprite.height)/h;
-            OLIVEC_PIXEL(oc, x, y) = OLIVEC_PIXEL(sprite, nx, ny);
+__attribute__((target("avx2")))
+static OLIVEC_ALWAYS_INLINE __m256i olivec_composite4_avx2(__m256i d, __m256i s, const Olivec_Blend_Mode mode)
+{
+    const __m256i c255 = _mm256_set1_epi16(255);
+    const __m256i alpha = _mm256_set_epi16(255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i sa = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, 0xFF), 0xFF);
+    __m256i da = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(d, 0xFF), 0xFF);
+    s = _mm256_or_si256(s, alpha);
+    __m256i fa, fb;
+    switch (mode) {
+    case OLIVEC_BLEND_CLEAR:     fa = zero;                       fb = zero;                       break;
+    case OLIVEC_BLEND_SRC:       fa = c255;                       fb = zero;                       break;
+    case OLIVEC_BLEND_DST:       fa = zero;                       fb = c255;                       break;
+    case OLIVEC_BLEND_DST_OVER:  fa = _mm256_sub_epi16(c255, da); fb = c255;                       break;
+    case OLIVEC_BLEND_SRC_IN:    fa = da;                         fb = zero;                       break;
+    case OLIVEC_BLEND_DST_IN:    fa = zero;                       fb = sa;                         break;
+    case OLIVEC_BLEND_SRC_OUT:   fa = _mm256_sub_epi16(c255, da); fb = zero;                       break;
+    case OLIVEC_BLEND_DST_OUT:   fa = zero;                       fb = _mm256_sub_epi16(c255, sa); break;
+    case OLIVEC_BLEND_SRC_ATOP:  fa = da;                         fb = _mm256_sub_epi16(c255, sa); break;
+    case OLIVEC_BLEND_DST_ATOP:  fa = _mm256_sub_epi16(c255, da); fb = sa;                         break;
+    case OLIVEC_BLEND_XOR:       fa = _mm256_sub_epi16(c255, da); fb = _mm256_sub_epi16(c255, sa); break;
+    case OLIVEC_BLEND_ADD:       fa = c255;                       fb = c255;                       break;
+    default: {
+        __m256i b;
+        switch (mode) {
+        case OLIVEC_BLEND_MULTIPLY: b = olivec_div255_avx2(_mm256_mullo_epi16(d, s)); break;
+        case OLIVEC_BLEND_SCREEN:   b = _mm256_sub_epi16(_mm256_add_epi16(d, s), olivec_div255_avx2(_mm256_mullo_epi16(d, s))); break;
+        case OLIVEC_BLEND_MIN:      b = _mm256_min_epi16(d, s); break;
+        case OLIVEC_BLEND_MAX:      b = _mm256_max_epi16(d, s); break;
+        default:                    b = s; break;
         }
+        return olivec_blend8_avx2(d, _mm256_or_si256(b, alpha), sa, _mm256_sub_epi16(c255, sa));
+    }
     }
+
+    const __m256i half = _mm256_set1_epi16(127);
+    __m256i a = olivec_div255_avx2(_mm256_add_epi16(_mm256_mullo_epi16(sa, fa), half));
+    return _mm256_add_epi16(olivec_div255_avx2(_mm256_add_epi16(_mm256_mullo_epi16(s, a), half)),
+                            olivec_div255_avx2(_mm256_add_epi16(_mm256_mullo_epi16(d, fb), half)));
 }
 
-// TODO: olivec_pixel_bilinear does not check for out-of-bounds
-// But maybe it shouldn't. Maybe it's a responsibility of the caller of the function.
-OLIVECDEF uint32_t olivec_pixel_bilinear(Olivec_Canvas sprite, int nx, int ny, int w, int h)
+__attribute__((target("avx2")))
+static OLIVEC_ALWAYS_INLINE void olivec_mode_span_avx2(uint32_t *dst, const uint32_t *src, uint32_t color, size_t n, const Olivec_Blend_Mode mode)
 {
-    int px = nx%w;
-    int py = ny%h;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i c = _mm256_set1_epi32((int) color);
+    for (; n >= 8; n -= 8, dst += 8) {
+        __m256i s = c;
+        if (src != NULL) {
+            s = _mm256_loadu_si256((const __m256i*) src);
+            src += 8;
+        }
+        __m256i d = _mm256_loadu_si256((const __m256i*) dst);
+        __m256i lo = olivec_composite4_avx2(_mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi8(s, zero), mode);
+        __m256i hi = olivec_composite4_avx2(_mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi8(s, zero), mode);
+        _mm256_storeu_si256((__m256i*) dst, _mm256_packus_epi16(lo, hi));
+    }
+    olivec_mode_span_sse2(dst, src, color, n, mode);
+}
+#endif // OLIVEC_X86_SIMD
 
-    int x1 = nx/w, x2 = nx/w;
-    int y1 = ny/h, y2 = ny/h;
-    if (px < w/2) {
-        // left
-        px += w/2;
-        x1 -= 1;
-        if (x1 < 0) x1 = 0;
-    } else {
-        // right
-        px -= w/2;
-        x2 += 1;
-        if ((size_t) x2 >= sprite.width) x2 = sprite.width - 1;
+// Every blend mode gets its own kernels for a color and for pixels, specialized from the templates above for every
+// instruction set. The AVX-512 level uses the AVX2 ones.
+typedef struct {
+    void (*span[OLIVEC_BLEND_COUNT])(uint32_t *dst, uint32_t color, size_t n);
+    void (*span_pixels[OLIVEC_BLEND_COUNT])(uint32_t *dst, const uint32_t *src, size_t n);
+} Olivec_Mode_Kernels;
+
+#define OLIVEC_TARGET_scalar
+#define OLIVEC_TARGET_sse2 __attribute__((target("sse2")))
+#define OLIVEC_TARGET_avx2 __attribute__((target("avx2")))
+
+#define OLIVEC_MODE_KERNEL(isa, mode) \
+    OLIVEC_TARGET_##isa static void olivec_mode_span_##isa##_##mode(uint32_t *dst, uint32_t color, size_t n) \
+    { \
+        olivec_mode_span_##isa(dst, NULL, color, n, OLIVEC_BLEND_##mode); \
+    } \
+    OLIVEC_TARGET_##isa static void olivec_mode_span_pixels_##isa##_##mode(uint32_t *dst, const uint32_t *src, size_t n) \
+    { \
+        olivec_mode_span_##isa(dst, src, 0, n, OLIVEC_BLEND_##mode); \
     }
+#define OLIVEC_MODE_SPAN_ENTRY(isa, mode) [OLIVEC_BLEND_##mode] = olivec_mode_span_##isa##_##mode,
+#define OLIVEC_MODE_SPAN_PIXELS_ENTRY(isa, mode) [OLIVEC_BLEND_##mode] = olivec_mode_span_pixels_##isa##_##mode,
 
-    if (py < h/2) {
-        // top
-        py += h/2;
-        y1 -= 1;
-        if (y1 < 0) y1 = 0;
-    } else {
-        // bottom
-        py -= h/2;
-        y2 += 1;
-        if ((size_t) y2 >= sprite.height) y2 = sprite.height - 1;
+#define OLIVEC_BLEND_MODES(X, isa) \
+    X(isa, SRC_OVER) X(isa, CLEAR) X(isa, SRC) X(isa, DST) X(isa, DST_OVER) X(isa, SRC_IN) X(isa, DST_IN) \
+    X(isa, SRC_OUT) X(isa, DST_OUT) X(isa, SRC_ATOP) X(isa, DST_ATOP) X(isa, XOR) X(isa, ADD) \
+    X(isa, MULTIPLY) X(isa, SCREEN) X(isa, MIN) X(isa, MAX)
+
+#define OLIVEC_MODE_KERNELS(isa) \
+    OLIVEC_BLEND_MODES(OLIVEC_MODE_KERNEL, isa) \
+    static const Olivec_Mode_Kernels olivec_mode_kernels_##isa = { \
+        .span = {OLIVEC_BLEND_MODES(OLIVEC_MODE_SPAN_ENTRY, isa)}, \
+        .span_pixels = {OLIVEC_BLEND_MODES(OLIVEC_MODE_SPAN_PIXELS_ENTRY, isa)}, \
+    };
+
+OLIVEC_MODE_KERNELS(scalar)
+#ifdef OLIVEC_X86_SIMD
+OLIVEC_MODE_KERNELS(sse2)
+OLIVEC_MODE_KERNELS(avx2)
+#endif
+
+typedef struct {
+    Olivec_Simd_Level level;
+    void (*fill_span)(uint32_t *dst, uint32_t color, size_t n);
+    void (*blend_span)(uint32_t *dst, uint32_t color, size_t n);
+    void (*blend_span_pixels)(uint32_t *dst, const uint32_t *src, size_t n);
+    bool (*edge_scan)(const int e[3], const int a[3], int n, int *first, int *last);
+    void (*bilinear_span)(uint32_t *dst, const uint32_t *r0, const uint32_t *r1, uint32_t fy, const uint32_t *columns, const uint32_t *weights, size_t n);
+    const Olivec_Mode_Kernels *modes;
+} Olivec_Kernels;
+
+static Olivec_Kernels olivec_kernels = {
+    .level = OLIVEC_SIMD_NONE,
+    .fill_span = olivec_fill_span_scalar,
+    .blend_span = olivec_blend_span_scalar,
+    .blend_span_pixels = olivec_blend_span_pixels_scalar,
+    .edge_scan = olivec_edge_scan_scalar,
+    .bilinear_span = olivec_bilinear_span_scalar,
+    .modes = &olivec_mode_kernels_scalar,
+};
+
+static Olivec_Simd_Level olivec_cpu_simd_level(void)
+{
+#ifdef OLIVEC_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return OLIVEC_SIMD_AVX512;
+    if (__builtin_cpu_supports("avx2")) return OLIVEC_SIMD_AVX2;
+    if (__builtin_cpu_supports("sse2")) return OLIVEC_SIMD_SSE2;
+#endif
+    return OLIVEC_SIMD_NONE;
+}
+
+OLIVECDEF Olivec_Simd_Level olivec_set_simd_level(Olivec_Simd_Level level)
+{
+    Olivec_Simd_Level supported = olivec_cpu_simd_level();
+    if (level > supported) level = supported;
+
+    olivec_kernels.level = level;
+    olivec_kernels.fill_span = olivec_fill_span_scalar;
+    olivec_kernels.blend_span = olivec_blend_span_scalar;
+    olivec_kernels.blend_span_pixels = olivec_blend_span_pixels_scalar;
+    olivec_kernels.edge_scan = olivec_edge_scan_scalar;
+    olivec_kernels.bilinear_span = olivec_bilinear_span_scalar;
+    olivec_kernels.modes = &olivec_mode_kernels_scalar;
+#ifdef OLIVEC_X86_SIMD
+    switch (level) {
+    case OLIVEC_SIMD_AVX512:
+        olivec_kernels.fill_span = olivec_fill_span_avx512;
+        olivec_kernels.blend_span = olivec_blend_span_avx512;
+        olivec_kernels.blend_span_pixels = olivec_blend_span_pixels_avx512;
+        olivec_kernels.edge_scan = olivec_edge_scan_avx512;
+        olivec_kernels.bilinear_span = olivec_bilinear_span_sse2;
+        olivec_kernels.modes = &olivec_mode_kernels_avx2;
+        break;
+    case OLIVEC_SIMD_AVX2:
+        olivec_kernels.fill_span = olivec_fill_span_avx2;
+        olivec_kernels.blend_span = olivec_blend_span_avx2;
+        olivec_kernels.blend_span_pixels = olivec_blend_span_pixels_avx2;
+        olivec_kernels.edge_scan = olivec_edge_scan_avx2;
+        olivec_kernels.bilinear_span = olivec_bilinear_span_sse2;
+        olivec_kernels.modes = &olivec_mode_kernels_avx2;
+        break;
+    case OLIVEC_SIMD_SSE2:
+        olivec_kernels.fill_span = olivec_fill_span_sse2;
+        olivec_kernels.blend_span = olivec_blend_span_sse2;
+        olivec_kernels.blend_span_pixels = olivec_blend_span_pixels_sse2;
+        olivec_kernels.edge_scan = olivec_edge_scan_sse2;
+        olivec_kernels.bilinear_span = olivec_bilinear_span_sse2;
+        olivec_kernels.modes = &olivec_mode_kernels_sse2;
+        break;
+    case OLIVEC_SIMD_NONE:
+        break;
     }
+#endif
+    return level;
+}
 
-    return mix_colors2(mix_colors2(OLIVEC_PIXEL(sprite, x1, y1),
-                                   OLIVEC_PIXEL(sprite, x2, y1),
-                                   px, w),
-                       mix_colors2(OLIVEC_PIXEL(sprite, x1, y2),
-                                   OLIVEC_PIXEL(sprite, x2, y2),
-                                   px, w),
-                       py, h);
+OLIVECDEF Olivec_Simd_Level olivec_simd_level(void)
+{
+    return olivec_kernels.level;
 }
 
-OLIVECDEF void olivec_sprite_copy_bilinear(Olivec_Canvas oc, int x, int y, int w, int h, Olivec_Canvas sprite)
+#ifdef OLIVEC_X86_SIMD
+__attribute__((constructor))
+static void olivec_simd_init(void)
 {
-    // TODO: support negative size in olivec_sprite_copy_bilinear()
-    if (w <= 0) return;
-    if (h <= 0) return;
+    olivec_set_simd_level(OLIVEC_SIMD_AVX512);
+}
+#endif
 
-    Olivec_Normalized_Rect nr = {0};
-    if (!olivec_normalize_rect(x, y, w, h, oc.width, oc.height, &nr)) return;
+OLIVECDEF void olivec_fill_span(uint32_t *dst, uint32_t color, size_t n)
+{
+    olivec_kernels.fill_span(dst, color, n);
+}
 
-    for (int y = nr.y1; y <= nr.y2; ++y) {
-        for (int x = nr.x1; x <= nr.x2; ++x) {
-            size_t nx = (x - nr.ox1)*sprite.width;
-            size_t ny = (y - nr.oy1)*sprite.height;
-            OLIVEC_PIXEL(oc, x, y) = olivec_pixel_bilinear(sprite, nx, ny, w, h);
-        }
+OLIVECDEF void olivec_blend_span(uint32_t *dst, uint32_t color, size_t n)
+{
+    uint32_t a = OLIVEC_ALPHA(color);
+    if (a == 0) return;
+    if (a == 255) {
+        olivec_kernels.fill_span(dst, color, n);
+        return;
     }
+    olivec_kernels.blend_span(dst, color, n);
+}
+
+OLIVECDEF void olivec_blend_span_pixels(uint32_t *dst, const uint32_t *src, size_t n)
+{
+    olivec_kernels.blend_span_pixels(dst, src, n);
+}
+
+OLIVECDEF void olivec_blend_color_mode(uint32_t *c1, uint32_t c2, Olivec_Blend_Mode mode)
+{
+    olivec_kernels.modes->span[mode](c1, c2, 1);
+}
+
+// Source-over keeps the fast paths of olivec_blend_span() and olivec_blend_span_pixels()
+OLIVECDEF void olivec_blend_span_mode(uint32_t *dst, uint32_t color, size_t n, Olivec_Blend_Mode mode)
+{
+    if (mode == OLIVEC_BLEND_SRC_OVER) olivec_blend_span(dst, color, n);
+    else if (mode != OLIVEC_BLEND_DST) olivec_kernels.modes->span[mode](dst, color, n);
+}
+
+OLIVECDEF void olivec_blend_span_pixels_mode(uint32_t *dst, const uint32_t *src, size_t n, Olivec_Blend_Mode mode)
+{
+    if (mode == OLIVEC_BLEND_SRC_OVER) olivec_blend_span_pixels(dst, src, n);
+    else if (mode != OLIVEC_BLEND_DST) olivec_kernels.modes->span_pixels[mode](dst, src, n);
+}
+
+typedef struct {
+    Olivec_Canvas oc;
+    uint32_t color;
+} Olivec_Fill_Job;
+
+static void olivec_fill_rows(void *user, size_t y1, size_t y2)
+{
+    Olivec_Fill_Job *job = user;
+    Olivec_Canvas oc = job->oc;
+    if (oc.stride == oc.width) {
+        // Contiguous canvas, all the rows are just one long span
+        olivec_fill_span(&OLIVEC_PIXEL(oc, 0, y1), job->color, oc.width*(y2 - y1));
+        return;
+    }
+    for (size_t y = y1; y < y2; ++y) {
+        olivec_fill_span(&OLIVEC_PIXEL(oc, 0, y), job->color, oc.width);
+    }
+}
+
+OLIVECDEF void olivec_fill(Olivec_Canvas oc, uint32_t color)
+{
+    Olivec_Fill_Job job = {oc, color};
+    olivec_parallel_for(oc.height, olivec_row_grain(oc.width), olivec_fill_rows, &job);
+}
+
+OLIVECDEF void olivec_rect(Olivec_Canvas oc, int x, int y, int w, int h, uint32_t color)
+{
+    Olivec_Normalized_Rect nr = {0};
+    if (!olivec_normalize_rect(x, y, w, h, oc.width, oc.height, &nr)) return;
+
+    uint32_t alpha = OLIVEC_ALPHA(color);
+    if (alpha == 0) return;
+
+    size_t n = nr.x2 - nr.x1 + 1;
+    if (alpha == 255) {
+        if (n == oc.width && oc.stride == oc.width) {
+            // Full rows of a contiguous canvas are just one long span
+            olivec_kernels.fill_span(&OLIVEC_PIXEL(oc, 0, nr.y1), color, n*(nr.y2 - nr.y1 + 1));
+            return;
+        }
+        for (int y = nr.y1; y <= nr.y2; ++y) {
+            olivec_kernels.fill_span(&OLIVEC_PIXEL(oc, nr.x1, y), color, n);
+        }
+    } else {
+        for (int y = nr.y1; y <= nr.y2; ++y) {
+            olivec_kernels.blend_span(&OLIVEC_PIXEL(oc, nr.x1, y), color, n);
+        }
+    }
+}
+
+OLIVECDEF void olivec_rect_mode(Olivec_Canvas oc, int x, int y, int w, int h, uint32_t color, Olivec_Blend_Mode mode)
+{
+    if (mode == OLIVEC_BLEND_SRC_OVER) {
+        olivec_rect(oc, x, y, w, h, color);
+        return;
+    }
+
+    Olivec_Normalized_Rect nr = {0};
+    if (!olivec_normalize_rect(x, y, w, h, oc.width, oc.height, &nr)) return;
+
+    size_t n = nr.x2 - nr.x1 + 1;
+    if (n == oc.width && oc.stride == oc.width) {
+        olivec_blend_span_mode(&OLIVEC_PIXEL(oc, 0, nr.y1), color, n*(nr.y2 - nr.y1 + 1), mode);
+        return;
+    }
+    for (int y = nr.y1; y <= nr.y2; ++y) {
+        olivec_blend_span_mode(&OLIVEC_PIXEL(oc, nr.x1, y), color, n, mode);
+    }
+}
+
+OLIVECDEF void olivec_frame(Olivec_Canvas oc, int x, int y, int w, int h, size_t t, uint32_t color)
+{
+    if (t == 0) return; // Nothing to render
+
+    // Convert the rectangle to 2-points representation
+    int x1 = x;
+    int y1 = y;
+    int x2 = x1 + OLIVEC_SIGN(int, w)*(OLIVEC_ABS(int, w) - 1);
+    if (x1 > x2) OLIVEC_SWAP(int, x1, x2);
+    int y2 = y1 + OLIVEC_SIGN(int, h)*(OLIVEC_ABS(int, h) - 1);
+    if (y1 > y2) OLIVEC_SWAP(int, y1, y2);
+
+    olivec_rect(oc, x1 - t/2, y1 - t/2, (x2 - x1 + 1) + t/2*2, t, color);  // Top
+    olivec_rect(oc, x1 - t/2, y1 - t/2, t, (y2 - y1 + 1) + t/2*2, color);  // Left
+    olivec_rect(oc, x1 - t/2, y2 + t/2, (x2 - x1 + 1) + t/2*2, -t, color); // Bottom
+    olivec_rect(oc, x2 + t/2, y1 - t/2, -t, (y2 - y1 + 1) + t/2*2, color); // Right
+}
+
+static void olivec_circle_run(Olivec_Canvas oc, int x1, int x2, int y, int count, uint32_t color)
+{
+    uint32_t alpha = ((color&0xFF000000)>>(3*8))*count/OLIVEC_AA_RES/OLIVEC_AA_RES;
+    uint32_t updated_color = (color&0x00FFFFFF)|(alpha<<(3*8));
+    olivec_blend_span(&OLIVEC_PIXEL(oc, x1, y), updated_color, x2 - x1 + 1);
+}
+
+// Largest d such that d*d <= n
+static int64_t olivec_isqrt(uint64_t n)
+{
+    uint64_t d = 0;
+    uint64_t bit = (uint64_t) 1 << 62;
+    while (bit > n) bit >>= 2;
+    while (bit != 0) {
+        if (n >= d + bit) {
+            n -= d + bit;
+            d = (d >> 1) + bit;
+        } else {
+            d >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (int64_t) d;
+}
+
+static int64_t olivec_floor_div(int64_t a, int64_t b)
+{
+    return a >= 0 ? a/b : -((-a + b - 1)/b);
+}
+
+// Square root without libm. Newton's iteration started above the root only ever decreases, so it stops as soon as
+// it does not anymore.
+static double olivec_sqrt(double x)
+{
+    if (x <= 0) return 0;
+    double r = 1;
+    while (r*r < x) r *= 2;
+    for (;;) {
+        double next = 0.5*(r + x/r);
+        if (next >= r) return r;
+        r = next;
+    }
+}
+
+// Scanline rasterizer shared by olivec_circle() and olivec_ellipse()
+//
+// Every pixel is covered by OLIVEC_AA_RES*OLIVEC_AA_RES samples. In units of 1/(2*res1) of a pixel the sample
+// (sox, soy) of the pixel (x, y) is at (dx, dy) relative to the center where dx = base(x) + 2*sox with
+// base(x) = 2*res1*(x - cx) + 2 - res1. For a given sample row the inside test boils down to |dx| <= half[soy],
+// which gives the fully covered interior of every row directly. Only the pixels at the ends of the row need their
+// samples counted.
+//
+// The squares are exact in 64 bits as long as 2*res1*r (circle) or 2*res1*rx*ry (ellipse) fits into 31 bits. Bigger
+// shapes are hardly ever visible as a whole, and for them half[] is computed in double instead.
+static void olivec_ellipse_rows(Olivec_Canvas oc, Olivec_Normalized_Rect nr, int cx, int cy, int rx, int ry, uint32_t color)
+{
+    const int64_t res1 = OLIVEC_AA_RES + 1;
+    // Circle:  dx*dx + dy*dy <= (2*res1*r)^2
+    // Ellipse: dx*dx*ry*ry + dy*dy*rx*rx <= (2*res1*rx*ry)^2
+    // A sample row is inside for |dy| <= 2*res1*ry either way.
+    const int64_t rxx = (int64_t) rx*rx;
+    const int64_t ryy = (int64_t) ry*ry;
+    const int64_t sy = 2*res1*ry;
+    const bool exact = rx == ry ? 2*res1*rx <= INT32_MAX : (int64_t) rx*ry <= INT32_MAX/(2*res1);
+    const int64_t rr = !exact ? 0 : rx == ry ? sy*sy : (sy*rx)*(sy*rx);
+    int64_t half[OLIVEC_AA_RES];
+    uint32_t opaque = color|0xFF000000;
+    bool is_opaque = (color&0xFF000000) == 0xFF000000;
+    if (rxx == 0 || ryy == 0) return;
+
+    for (int y = nr.y1; y <= nr.y2; ++y) {
+        int64_t min_half = INT64_MAX, max_half = -1;
+        for (int soy = 0; soy < OLIVEC_AA_RES; ++soy) {
+            int64_t dy = 2*res1*((int64_t) y - cy) + 2 + soy*2 - res1;
+            int64_t ady = dy < 0 ? -dy : dy;
+            if (ady > sy) {
+                half[soy] = -1;
+            } else if (!exact) {
+                half[soy] = (int64_t) (olivec_sqrt((double) (sy - ady)*(double) (sy + ady))*rx/ry);
+            } else if (rx == ry) {
+                half[soy] = olivec_isqrt(rr - dy*dy);
+            } else {
+                half[soy] = olivec_isqrt((rr - dy*dy*rxx)/ryy);
+            }
+            if (half[soy] < min_half) min_half = half[soy];
+            if (half[soy] > max_half) max_half = half[soy];
+        }
+        if (max_half < 0) continue;
+
+        // Pixels with at least one sample inside
+        int64_t ax1 = cx + olivec_floor_div(-max_half + res1 - 2*OLIVEC_AA_RES + 2*res1 - 1, 2*res1);
+        int64_t ax2 = cx + olivec_floor_div(max_half + res1 - 2, 2*res1);
+        // Pixels with all of the samples inside
+        int64_t fx1 = cx + olivec_floor_div(res1 - 2 - min_half + 2*res1 - 1, 2*res1);
+        int64_t fx2 = cx + olivec_floor_div(min_half + res1 - 2*OLIVEC_AA_RES, 2*res1);
+        if (ax1 < nr.x1) ax1 = nr.x1;
+        if (ax2 > nr.x2) ax2 = nr.x2;
+        if (fx1 < ax1) fx1 = ax1;
+        if (fx2 > ax2) fx2 = ax2;
+        bool has_full = min_half >= 0 && fx1 <= fx2;
+
+        // Edge pixels. Consecutive pixels with the same coverage are blended as one span
+        int run_x = (int) ax1;
+        int run_count = -1;
+        for (int64_t x = ax1; x <= ax2 + 1; ++x) {
+            if (has_full && x == fx1) {
+                if (run_count > 0) olivec_circle_run(oc, run_x, (int) x - 1, y, run_count, color);
+                if (is_opaque) {
+                    olivec_fill_span(&OLIVEC_PIXEL(oc, x, y), opaque, (size_t) (fx2 - fx1 + 1));
+                } else {
+                    olivec_circle_run(oc, (int) fx1, (int) fx2, y, OLIVEC_AA_RES*OLIVEC_AA_RES, color);
+                }
+                x = fx2 + 1;
+                run_x = (int) x;
+                run_count = -1;
+            }
+
+            int count = 0;
+            if (x <= ax2) {
+                int64_t base = 2*res1*(x - cx) + 2 - res1;
+                for (int soy = 0; soy < OLIVEC_AA_RES; ++soy) {
+                    for (int sox = 0; sox < OLIVEC_AA_RES; ++sox) {
+                        int64_t dx = base + 2*sox;
+                        if (-half[soy] <= dx && dx <= half[soy]) count += 1;
+                    }
+                }
+            } else {
+                count = -2;
+            }
+            if (count != run_count) {
+                if (run_count > 0) olivec_circle_run(oc, run_x, (int) x - 1, y, run_count, color);
+                run_x = (int) x;
+                run_count = count;
+            }
+        }
+    }
+}
+
+// The pixels an ellipse with the radii rx, ry can touch, clipped to the canvas. The box is computed in 64 bits so any
+// int center and radii are fine. The radii are returned as absolute values, with INT_MIN saturating to INT_MAX.
+static bool olivec_ellipse_rect(Olivec_Canvas oc, int cx, int cy, int *rx, int *ry, Olivec_Normalized_Rect *nr)
+{
+    int64_t arx = *rx < 0 ? -(int64_t) *rx : *rx;
+    int64_t ary = *ry < 0 ? -(int64_t) *ry : *ry;
+    if (arx == 0 || ary == 0) return false;
+    if (arx > INT32_MAX) arx = INT32_MAX;
+    if (ary > INT32_MAX) ary = INT32_MAX;
+    *rx = (int) arx;
+    *ry = (int) ary;
+
+    int64_t x1 = (int64_t) cx - arx - 1, x2 = (int64_t) cx + arx + 1;
+    int64_t y1 = (int64_t) cy - ary - 1, y2 = (int64_t) cy + ary + 1;
+    if (x1 < -1) x1 = -1;
+    if (y1 < -1) y1 = -1;
+    if (x2 > (int64_t) oc.width) x2 = (int64_t) oc.width;
+    if (y2 > (int64_t) oc.height) y2 = (int64_t) oc.height;
+    if (x1 > x2 || y1 > y2) return false;
+    return olivec_normalize_rect((int) x1, (int) y1, (int) (x2 - x1 + 1), (int) (y2 - y1 + 1), oc.width, oc.height, nr);
+}
+
+OLIVECDEF void olivec_circle(Olivec_Canvas oc, int cx, int cy, int r, uint32_t color)
+{
+    Olivec_Normalized_Rect nr = {0};
+    int ry = r;
+    if (!olivec_ellipse_rect(oc, cx, cy, &r, &ry, &nr)) return;
+    olivec_ellipse_rows(oc, nr, cx, cy, r, r, color);
+}
+
+// Uses the same sampling as olivec_circle(), so olivec_ellipse(oc, cx, cy, r, r, color) is the same as
+// olivec_circle(oc, cx, cy, r, color)
+OLIVECDEF void olivec_ellipse(Olivec_Canvas oc, int cx, int cy, int rx, int ry, uint32_t color)
+{
+    Olivec_Normalized_Rect nr = {0};
+    if (!olivec_ellipse_rect(oc, cx, cy, &rx, &ry, &nr)) return;
+    olivec_ellipse_rows(oc, nr, cx, cy, rx, ry, color);
+}
+
+OLIVECDEF bool olivec_in_bounds(Olivec_Canvas oc, int x, int y)
+{
+    return 0 <= x && x < (int) oc.width && 0 <= y && y < (int) oc.height;
+}
+
+static int64_t olivec_ceil_div(int64_t a, int64_t b)
+{
+    return -olivec_floor_div(-a, b);
+}
+
+// Narrows [*t1, *t2] down to the steps t >= 0 of a line for which v + dv*t/d (rounded towards zero like the C
+// division) stays inside of [0, n). d must be positive.
+static void olivec_line_clip(int v, int dv, int d, int n, int64_t *t1, int64_t *t2)
+{
+    int64_t lo, hi;
+    if (dv > 0) {
+        lo = olivec_ceil_div(-(int64_t) v*d, dv);
+        hi = olivec_ceil_div((int64_t) (n - v)*d, dv) - 1;
+    } else if (dv < 0) {
+        lo = olivec_ceil_div((int64_t) (v - n + 1)*d, -(int64_t) dv);
+        hi = olivec_ceil_div((int64_t) (v + 1)*d, -(int64_t) dv) - 1;
+    } else {
+        lo = 0;
+        hi = 0 <= v && v < n ? *t2 : -1;
+    }
+    if (lo > *t1) *t1 = lo;
+    if (hi < *t2) *t2 = hi;
+}
+
+// Incremental form of dv*t/d rounded towards zero like the C division, q is the value for the current t.
+// Only valid for |dv| <= d, which holds for the minor axis of a line. The stepping is branchless because
+// whether q moves on the next step is about as predictable as a coin flip.
+typedef struct {
+    int64_t q, rem;
+    int64_t sign, e, d;
+} Olivec_Dda;
+
+static Olivec_Dda olivec_dda(int dv, int d, int64_t t)
+{
+    Olivec_Dda dda = {.sign = dv < 0 ? -1 : 1, .e = OLIVEC_ABS(int64_t, (int64_t) dv), .d = d};
+    if (t > 0) {
+        int64_t p = dda.e*t/d;
+        dda.rem = dda.e*t - p*d;
+        dda.q = dda.sign*p;
+    }
+    return dda;
+}
+
+// Returns whether q has moved
+static inline bool olivec_dda_step(Olivec_Dda *dda)
+{
+    int64_t next = dda->rem + dda->e - dda->d;
+    bool carry = next >= 0;
+    dda->q += carry ? dda->sign : 0;
+    dda->rem = carry ? next : next + dda->d;
+    return carry;
+}
+
+// The pixels are the same as stepping the line from end to end and dropping the ones outside of the canvas, the
+// line is just clipped to the canvas before any of them are visited.
+OLIVECDEF void olivec_line(Olivec_Canvas oc, int x1, int y1, int x2, int y2, uint32_t color)
+{
+    int dx = x2 - x1;
+    int dy = y2 - y1;
+
+    // If both of the differences are 0 there will be a division by 0 below.
+    if (dx == 0 && dy == 0) {
+        if (olivec_in_bounds(oc, x1, y1)) {
+            olivec_blend_color(&OLIVEC_PIXEL(oc, x1, y1), color);
+        }
+        return;
+    }
+
+    // Lines that are entirely inside of the canvas do not need any clipping
+    bool inside = olivec_in_bounds(oc, x1, y1) && olivec_in_bounds(oc, x2, y2);
+
+    if (OLIVEC_ABS(int, dx) > OLIVEC_ABS(int, dy)) {
+        if (x1 > x2) {
+            OLIVEC_SWAP(int, x1, x2);
+            OLIVEC_SWAP(int, y1, y2);
+            dx = -dx;
+            dy = -dy;
+        }
+
+        int64_t t1 = 0, t2 = dx;
+        if (!inside) {
+            olivec_line_clip(x1, 1, 1, oc.width, &t1, &t2);
+            olivec_line_clip(y1, dy, dx, oc.height, &t1, &t2);
+            if (t1 > t2) return;
+        }
+
+        Olivec_Dda dda = olivec_dda(dy, dx, t1);
+        if (OLIVEC_ABS(int, dy)*8 > dx) {
+            uint32_t *pixel = &OLIVEC_PIXEL(oc, x1 + t1, y1 + dda.q);
+            ptrdiff_t minor = (ptrdiff_t) dda.sign*(ptrdiff_t) oc.stride;
+            for (int64_t t = t1; ; ++t) {
+                olivec_blend_color(pixel, color);
+                if (t == t2) break;
+                pixel += 1 + (olivec_dda_step(&dda) ? minor : 0);
+            }
+            return;
+        }
+
+        // Pixels of a mostly horizontal line form long horizontal runs, blend them as spans
+        int64_t run_t = t1;
+        int64_t run_q = dda.q;
+        for (int64_t t = t1 + 1; t <= t2; ++t) {
+            olivec_dda_step(&dda);
+            if (dda.q == run_q) continue;
+            olivec_blend_span(&OLIVEC_PIXEL(oc, x1 + run_t, y1 + run_q), color, (size_t) (t - run_t));
+            run_t = t;
+            run_q = dda.q;
+        }
+        olivec_blend_span(&OLIVEC_PIXEL(oc, x1 + run_t, y1 + run_q), color, (size_t) (t2 + 1 - run_t));
+    } else {
+        if (y1 > y2) {
+            OLIVEC_SWAP(int, x1, x2);
+            OLIVEC_SWAP(int, y1, y2);
+            dx = -dx;
+            dy = -dy;
+        }
+
+        int64_t t1 = 0, t2 = dy;
+        if (!inside) {
+            olivec_line_clip(y1, 1, 1, oc.height, &t1, &t2);
+            olivec_line_clip(x1, dx, dy, oc.width, &t1, &t2);
+            if (t1 > t2) return;
+        }
+
+        Olivec_Dda dda = olivec_dda(dx, dy, t1);
+        uint32_t *pixel = &OLIVEC_PIXEL(oc, x1 + dda.q, y1 + t1);
+        ptrdiff_t major = (ptrdiff_t) oc.stride;
+        for (int64_t t = t1; ; ++t) {
+            olivec_blend_color(pixel, color);
+            if (t == t2) break;
+            pixel += major + (olivec_dda_step(&dda) ? dda.sign : 0);
+        }
+    }
+}
+
+static inline void olivec_line_aa_blend(uint32_t *pixel, uint32_t color, uint32_t coverage)
+{
+    uint32_t alpha = (OLIVEC_ALPHA(color)*coverage) >> 8;
+    if (alpha > 0) olivec_blend_color(pixel, (color&0x00FFFFFF)|(alpha<<(3*8)));
+}
+
+OLIVECDEF void olivec_line_aa(Olivec_Canvas oc, int x1, int y1, int x2, int y2, uint32_t color)
+{
+    int dx = x2 - x1;
+    int dy = y2 - y1;
+    if (dx == 0 && dy == 0) {
+        if (olivec_in_bounds(oc, x1, y1)) {
+            olivec_blend_color(&OLIVEC_PIXEL(oc, x1, y1), color);
+        }
+        return;
+    }
+
+    // Step along the major axis a and cover two pixels along the minor axis b every time
+    bool steep = OLIVEC_ABS(int, dy) > OLIVEC_ABS(int, dx);
+    int a1 = steep ? y1 : x1;
+    int b1 = steep ? x1 : y1;
+    int da = steep ? dy : dx;
+    int db = steep ? dx : dy;
+    if (da < 0) {
+        a1 += da;
+        b1 += db;
+        da = -da;
+        db = -db;
+    }
+    int na = (int) (steep ? oc.height : oc.width);
+    int nb = (int) (steep ? oc.width : oc.height);
+    size_t step_a = steep ? oc.stride : 1;
+    size_t step_b = steep ? 1 : oc.stride;
+
+    // Minor coordinate in 16.16 fixed point, offset by one pixel so it never goes negative inside of the canvas
+    const int64_t one = 1 << 16;
+    int64_t grad = olivec_floor_div((int64_t) db*one*2 + da, (int64_t) da*2);
+    int64_t b0 = (int64_t) b1*one + one;
+
+    int64_t t1 = 0, t2 = da;
+    olivec_line_clip(a1, 1, 1, na, &t1, &t2);
+    // Only the steps where one of the two pixels lands inside of [0, nb)
+    if (grad > 0) {
+        int64_t lo = olivec_ceil_div(-b0, grad);
+        int64_t hi = olivec_floor_div((int64_t) (nb + 1)*one - 1 - b0, grad);
+        if (lo > t1) t1 = lo;
+        if (hi < t2) t2 = hi;
+    } else if (grad < 0) {
+        int64_t lo = olivec_ceil_div(b0 - ((int64_t) (nb + 1)*one - 1), -grad);
+        int64_t hi = olivec_floor_div(b0, -grad);
+        if (lo > t1) t1 = lo;
+        if (hi < t2) t2 = hi;
+    } else if (b0 < 0 || b0 > (int64_t) (nb + 1)*one - 1) {
+        return;
+    }
+    if (t1 > t2) return;
+
+    int64_t b = b0 + grad*t1;
+    for (int64_t t = t1; t <= t2; ++t, b += grad) {
+        int r = (int) (b >> 16) - 1;
+        uint32_t frac = (uint32_t) (b >> 8)&0xFF;
+        uint32_t *pixel = &oc.pixels[(size_t) (a1 + t)*step_a];
+        if (r >= 0) olivec_line_aa_blend(&pixel[(size_t) r*step_b], color, 256 - frac);
+        if (r + 1 < nb) olivec_line_aa_blend(&pixel[(size_t) (r + 1)*step_b], color, frac);
+    }
+}
+
+OLIVECDEF uint32_t mix_colors2(uint32_t c1, uint32_t c2, int u1, int det)
+{
+    // TODO: estimate how much overflows are an issue in integer only environment
+    int64_t r1 = OLIVEC_RED(c1);
+    int64_t g1 = OLIVEC_GREEN(c1);
+    int64_t b1 = OLIVEC_BLUE(c1);
+    int64_t a1 = OLIVEC_ALPHA(c1);
+
+    int64_t r2 = OLIVEC_RED(c2);
+    int64_t g2 = OLIVEC_GREEN(c2);
+    int64_t b2 = OLIVEC_BLUE(c2);
+    int64_t a2 = OLIVEC_ALPHA(c2);
+
+    if (det != 0) {
+        int u2 = det - u1;
+        int64_t r4 = (r1*u2 + r2*u1)/det;
+        int64_t g4 = (g1*u2 + g2*u1)/det;
+        int64_t b4 = (b1*u2 + b2*u1)/det;
+        int64_t a4 = (a1*u2 + a2*u1)/det;
+
+        return OLIVEC_RGBA(r4, g4, b4, a4);
+    }
+
+    return 0;
+}
+
+OLIVECDEF uint32_t mix_colors3(uint32_t c1, uint32_t c2, uint32_t c3, int u1, int u2, int det)
+{
+    // TODO: estimate how much overflows are an issue in integer only environment
+    int64_t r1 = OLIVEC_RED(c1);
+    int64_t g1 = OLIVEC_GREEN(c1);
+    int64_t b1 = OLIVEC_BLUE(c1);
+    int64_t a1 = OLIVEC_ALPHA(c1);
+
+    int64_t r2 = OLIVEC_RED(c2);
+    int64_t g2 = OLIVEC_GREEN(c2);
+    int64_t b2 = OLIVEC_BLUE(c2);
+    int64_t a2 = OLIVEC_ALPHA(c2);
+
+    int64_t r3 = OLIVEC_RED(c3);
+    int64_t g3 = OLIVEC_GREEN(c3);
+    int64_t b3 = OLIVEC_BLUE(c3);
+    int64_t a3 = OLIVEC_ALPHA(c3);
+
+    if (det != 0) {
+        int u3 = det - u1 - u2;
+        int64_t r4 = (r1*u1 + r2*u2 + r3*u3)/det;
+        int64_t g4 = (g1*u1 + g2*u2 + g3*u3)/det;
+        int64_t b4 = (b1*u1 + b2*u2 + b3*u3)/det;
+        int64_t a4 = (a1*u1 + a2*u2 + a3*u3)/det;
+
+        return OLIVEC_RGBA(r4, g4, b4, a4);
+    }
+
+    return 0;
+}
+
+// NOTE: we imply u3 = det - u1 - u2
+OLIVECDEF bool olivec_barycentric(int x1, int y1, int x2, int y2, int x3, int y3, int xp, int yp, int *u1, int *u2, int *det)
+{
+    *det = ((x1 - x3)*(y2 - y3) - (x2 - x3)*(y1 - y3));
+    *u1  = ((y2 - y3)*(xp - x3) + (x3 - x2)*(yp - y3));
+    *u2  = ((y3 - y1)*(xp - x3) + (x1 - x3)*(yp - y3));
+    int u3 = *det - *u1 - *u2;
+    return (
+               (OLIVEC_SIGN(int, *u1) == OLIVEC_SIGN(int, *det) || *u1 == 0) &&
+               (OLIVEC_SIGN(int, *u2) == OLIVEC_SIGN(int, *det) || *u2 == 0) &&
+               (OLIVEC_SIGN(int, u3) == OLIVEC_SIGN(int, *det) || u3 == 0)
+           );
+}
+
+OLIVECDEF bool olivec_normalize_triangle(size_t width, size_t height, int x1, int y1, int x2, int y2, int x3, int y3, int *lx, int *hx, int *ly, int *hy)
+{
+    *lx = x1;
+    *hx = x1;
+    if (*lx > x2) *lx = x2;
+    if (*lx > x3) *lx = x3;
+    if (*hx < x2) *hx = x2;
+    if (*hx < x3) *hx = x3;
+    if (*lx < 0) *lx = 0;
+    if ((size_t) *lx >= width) return false;;
+    if (*hx < 0) return false;;
+    if ((size_t) *hx >= width) *hx = width-1;
+
+    *ly = y1;
+    *hy = y1;
+    if (*ly > y2) *ly = y2;
+    if (*ly > y3) *ly = y3;
+    if (*hy < y2) *hy = y2;
+    if (*hy < y3) *hy = y3;
+    if (*ly < 0) *ly = 0;
+    if ((size_t) *ly >= height) return false;;
+    if (*hy < 0) return false;;
+    if ((size_t) *hy >= height) *hy = height-1;
+
+    return true;
+}
+
+OLIVECDEF bool olivec_triangle_setup(Olivec_Triangle *t, size_t width, size_t height, int x1, int y1, int x2, int y2, int x3, int y3)
+{
+    if (!olivec_normalize_triangle(width, height, x1, y1, x2, y2, x3, y3, &t->lx, &t->hx, &t->ly, &t->hy)) return false;
+
+    // Same equations as olivec_barycentric(), just with the terms regrouped by x and y
+    t->det = (x1 - x3)*(y2 - y3) - (x2 - x3)*(y1 - y3);
+    if (t->det == 0) return false;
+
+    t->a[0] = y2 - y3;
+    t->b[0] = x3 - x2;
+    t->c[0] = -t->a[0]*x3 - t->b[0]*y3;
+
+    t->a[1] = y3 - y1;
+    t->b[1] = x1 - x3;
+    t->c[1] = -t->a[1]*x3 - t->b[1]*y3;
+
+    t->a[2] = -t->a[0] - t->a[1];
+    t->b[2] = -t->b[0] - t->b[1];
+    t->c[2] = t->det - t->c[0] - t->c[1];
+
+    // Flipping all the signs keeps every u/det ratio the same
+    if (t->det < 0) {
+        t->det = -t->det;
+        for (int i = 0; i < 3; ++i) {
+            t->a[i] = -t->a[i];
+            t->b[i] = -t->b[i];
+            t->c[i] = -t->c[i];
+        }
+    }
+
+    t->y = t->ly;
+    for (int i = 0; i < 3; ++i) t->row[i] = t->a[i]*t->lx + t->b[i]*t->ly + t->c[i];
+    t->strip_hy = t->ly - 1;
+    return true;
+}
+
+// Classifies the blocks of the strip of rows starting at t->y using the edge values at their corners. A block is
+// rejected when it is completely outside of any edge and fully covered when it is inside of all of them.
+static void olivec_triangle_strip(Olivec_Triangle *t)
+{
+    int y1 = t->y;
+    int y2 = y1 + OLIVEC_TRIANGLE_BLOCK - 1;
+    if (y2 > t->hy) y2 = t->hy;
+    int bh = y2 - y1;
+
+    t->strip_hy = y2;
+    t->px1 = t->fx1 = t->hx + 1;
+    t->px2 = t->fx2 = t->lx - 1;
+
+    int e[3] = {t->row[0], t->row[1], t->row[2]};
+    for (int x1 = t->lx; x1 <= t->hx; x1 += OLIVEC_TRIANGLE_BLOCK) {
+        int x2 = x1 + OLIVEC_TRIANGLE_BLOCK - 1;
+        if (x2 > t->hx) x2 = t->hx;
+        int bw = x2 - x1;
+
+        bool rejected = false, full = true;
+        for (int i = 0; i < 3; ++i) {
+            int lo = e[i] + (t->a[i] < 0 ? t->a[i]*bw : 0) + (t->b[i] < 0 ? t->b[i]*bh : 0);
+            int hi = e[i] + (t->a[i] > 0 ? t->a[i]*bw : 0) + (t->b[i] > 0 ? t->b[i]*bh : 0);
+            if (hi < 0) rejected = true;
+            if (lo < 0) full = false;
+            e[i] += t->a[i]*OLIVEC_TRIANGLE_BLOCK;
+        }
+
+        if (rejected) {
+            // The blocks that are not outside of an edge are contiguous within the strip, so are the ones
+            // that are not outside of all three.
+            if (t->px1 <= t->px2) break;
+            continue;
+        }
+        if (t->px1 > x1) t->px1 = x1;
+        t->px2 = x2;
+        if (full) {
+            if (t->fx1 > x1) t->fx1 = x1;
+            t->fx2 = x2;
+        }
+    }
+}
+
+// Finds the covered pixels of the current row within the columns x1..x2.
+static bool olivec_triangle_scan(const Olivec_Triangle *t, int x1, int x2, int *first, int *last)
+{
+    int e[3];
+    for (int i = 0; i < 3; ++i) e[i] = t->row[i] + t->a[i]*(x1 - t->lx);
+    if (!olivec_kernels.edge_scan(e, t->a, x2 - x1 + 1, first, last)) return false;
+    *first += x1;
+    *last += x1;
+    return true;
+}
+
+// Returns the covered span lx..hx of the next non-empty row y together with the barycentric weights at (lx, y).
+OLIVECDEF bool olivec_triangle_next_span(Olivec_Triangle *t, int *y, int *lx, int *hx, int *u1, int *u2)
+{
+    while (t->y <= t->hy) {
+        if (t->y > t->strip_hy) olivec_triangle_strip(t);
+
+        int first = 0, last = -1;
+        bool covered = false;
+        if (t->fx1 <= t->fx2) {
+            // Fully covered blocks need no per pixel tests. Since the row is covered contiguously
+            // only the partial blocks to the left and to the right of them have to be scanned.
+            int f, l;
+            covered = true;
+            first = t->fx1;
+            last = t->fx2;
+            if (t->px1 < t->fx1 && olivec_triangle_scan(t, t->px1, t->fx1 - 1, &f, &l)) first = f;
+            if (t->fx2 < t->px2 && olivec_triangle_scan(t, t->fx2 + 1, t->px2, &f, &l)) last = l;
+        } else if (t->px1 <= t->px2) {
+            covered = olivec_triangle_scan(t, t->px1, t->px2, &first, &last);
+        }
+
+        *y = t->y;
+        *u1 = t->row[0] + t->a[0]*(first - t->lx);
+        *u2 = t->row[1] + t->a[1]*(first - t->lx);
+
+        t->y += 1;
+        for (int i = 0; i < 3; ++i) t->row[i] += t->b[i];
+
+        if (covered) {
+            *lx = first;
+            *hx = last;
+            return true;
+        }
+    }
+    return false;
+}
+
+OLIVECDEF void olivec_uv_setup(Olivec_Uv *uv, const Olivec_Triangle *t, float tx1, float ty1, float tx2, float ty2, float tx3, float ty3, float z1, float z2, float z3)
+{
+    float v1[3] = {z1, tx1, ty1};
+    float v2[3] = {z2, tx2, ty2};
+    float v3[3] = {z3, tx3, ty3};
+    for (int i = 0; i < 3; ++i) {
+        uv->c[i] = v3[i];
+        uv->k1[i] = (v1[i] - v3[i])/t->det;
+        uv->k2[i] = (v2[i] - v3[i])/t->det;
+        uv->dx[i] = uv->k1[i]*t->a[0] + uv->k2[i]*t->a[1];
+    }
+}
+
+// Length of the run of pixels from x to the next multiple of OLIVEC_UV_SUBSPAN or hx
+static inline int olivec_uv_run(int x, int hx)
+{
+    int n = OLIVEC_UV_SUBSPAN - x%OLIVEC_UV_SUBSPAN;
+    return n < hx - x + 1 ? n : hx - x + 1;
+}
+
+// z of the pixel with the barycentric weights u1 and u2
+static inline float olivec_uv_z(const Olivec_Uv *uv, int u1, int u2)
+{
+    return uv->c[0] + uv->k1[0]*u1 + uv->k2[0]*u2;
+}
+
+// Texture coordinates of the run of pixels from x, which has the barycentric weights u1 and u2, to the next multiple of
+// OLIVEC_UV_SUBSPAN or hx. Returns the length of the run.
+OLIVECDEF int olivec_uv_span(const Olivec_Uv *uv, int x, int hx, int u1, int u2, float *u, float *v)
+{
+    int n = olivec_uv_run(x, hx);
+
+    float z = olivec_uv_z(uv, u1, u2);
+    float tx = uv->c[1] + uv->k1[1]*u1 + uv->k2[1]*u2;
+    float ty = uv->c[2] + uv->k1[2]*u1 + uv->k2[2]*u2;
+    float r = 1/z;
+    float su = tx*r, sv = ty*r;
+    u[0] = su;
+    v[0] = sv;
+    if (n <= 1) return n;
+
+    int m = n - 1;
+    r = 1/(z + uv->dx[0]*m);
+    float du = ((tx + uv->dx[1]*m)*r - su)/m;
+    float dv = ((ty + uv->dx[2]*m)*r - sv)/m;
+    for (int i = 1; i < n; ++i) {
+        u[i] = su + du*i;
+        v[i] = sv + dv*i;
+    }
+    return n;
+}
+
+// True if nothing closer than z passes the depth test in the tile (tx, ty)
+static bool olivec_hiz_hides(Olivec_Depth db, int tx, int ty, float z)
+{
+    Olivec_Hiz_Tile *tile = &db.hiz[ty*OLIVEC_HIZ_COLUMNS(db.width) + tx];
+    if (z <= tile->farthest) return true;
+    // Refreshing the farthest depth can not help if z is in front of everything in the tile. Refreshing it only
+    // after a tile worth of writes keeps the cost of the scans below one read per written pixel.
+    if (tile->written < OLIVEC_HIZ_SIZE*OLIVEC_HIZ_SIZE || z > tile->closest) return false;
+
+    size_t x1 = tx*OLIVEC_HIZ_SIZE, x2 = x1 + OLIVEC_HIZ_SIZE;
+    size_t y1 = ty*OLIVEC_HIZ_SIZE, y2 = y1 + OLIVEC_HIZ_SIZE;
+    if (x2 > db.width) x2 = db.width;
+    if (y2 > db.height) y2 = db.height;
+    float farthest = tile->closest;
+    for (size_t y = y1; y < y2; ++y) {
+        const float *depths = &OLIVEC_DEPTH(db, 0, y);
+        for (size_t x = x1; x < x2; ++x) farthest = depths[x] < farthest ? depths[x] : farthest;
+    }
+    tile->farthest = farthest;
+    tile->written = 0;
+    return z <= farthest;
+}
+
+// Sets up the triangle over the part of the canvas the depth buffer covers. Triangles behind the farthest depths of
+// all the tiles they touch are rejected like triangles outside of the canvas.
+static bool olivec_triangle_setup_depth(Olivec_Triangle *t, Olivec_Canvas oc, Olivec_Depth db, int x1, int y1, int x2, int y2, int x3, int y3, float z1, float z2, float z3)
+{
+    size_t width = oc.width < db.width ? oc.width : db.width;
+    size_t height = oc.height < db.height ? oc.height : db.height;
+    if (!olivec_triangle_setup(t, width, height, x1, y1, x2, y2, x3, y3)) return false;
+    if (db.hiz == NULL) return true;
+
+    float z = z1 > z2 ? z1 : z2;
+    if (z < z3) z = z3;
+    for (int ty = t->ly/OLIVEC_HIZ_SIZE; ty <= t->hy/OLIVEC_HIZ_SIZE; ++ty) {
+        for (int tx = t->lx/OLIVEC_HIZ_SIZE; tx <= t->hx/OLIVEC_HIZ_SIZE; ++tx) {
+            if (!olivec_hiz_hides(db, tx, ty, z)) return true;
+        }
+    }
+    return false;
+}
+
+// Tests the n <= 64 pixels from (x, y) with the depths z + dz*i against the depth buffer, stores the ones that pass
+// and returns them as a bit mask
+static uint64_t olivec_depth_test(Olivec_Depth db, int x, int y, int n, float z, float dz)
+{
+    float closest = dz > 0 ? z + dz*(n - 1) : z;
+    int tx1 = x/OLIVEC_HIZ_SIZE, tx2 = (x + n - 1)/OLIVEC_HIZ_SIZE, ty = y/OLIVEC_HIZ_SIZE;
+    if (db.hiz != NULL) {
+        bool hidden = true;
+        for (int tx = tx1; tx <= tx2 && hidden; ++tx) hidden = olivec_hiz_hides(db, tx, ty, closest);
+        if (hidden) return 0;
+    }
+
+    float *depths = &OLIVEC_DEPTH(db, x, y);
+    uint64_t mask = 0;
+    uint32_t written = 0;
+    for (int i = 0; i < n; ++i) {
+        float d = z + dz*i;
+        if (d > depths[i]) {
+            depths[i] = d;
+            mask |= (uint64_t) 1 << i;
+            written += 1;
+        }
+    }
+
+    if (db.hiz != NULL && mask != 0) {
+        for (int tx = tx1; tx <= tx2; ++tx) {
+            Olivec_Hiz_Tile *tile = &db.hiz[ty*OLIVEC_HIZ_COLUMNS(db.width) + tx];
+            tile->written += written;
+            if (tile->closest < closest) tile->closest = closest;
+        }
+    }
+    return mask;
+}
+
+// Bilinear sample of the level at the texture coordinates (u, v) in [0, 1] with the texel centers at half texels
+static uint32_t olivec_texture_sample_bilinear(Olivec_Canvas level, float u, float v)
+{
+    float x = u*level.width*256 - 128;
+    float y = v*level.height*256 - 128;
+    int sx = x < 0 ? 0 : x > (float) (level.width - 1)*256 ? (int) (level.width - 1)*256 : (int) x;
+    int sy = y < 0 ? 0 : y > (float) (level.height - 1)*256 ? (int) (level.height - 1)*256 : (int) y;
+    size_t x0 = sx >> 8, y0 = sy >> 8;
+    size_t x1 = x0 + 1 < level.width ? x0 + 1 : x0;
+    size_t y1 = y0 + 1 < level.height ? y0 + 1 : y0;
+    uint32_t top = olivec_lerp_color(OLIVEC_PIXEL(level, x0, y0), OLIVEC_PIXEL(level, x1, y0), sx&255);
+    uint32_t bottom = olivec_lerp_color(OLIVEC_PIXEL(level, x0, y1), OLIVEC_PIXEL(level, x1, y1), sx&255);
+    return olivec_lerp_color(top, bottom, sy&255);
+}
+
+// Rasterizer variants
+//
+// Every triangle is drawn by olivec_raster_spans(), which is specialized at compile time for every combination of
+// depth test, shading and writing by OLIVEC_RASTER_VARIANTS() and picked from a table once per triangle by
+// olivec_raster_draw(). The features are constant in every specialization, so the loops carry no branches or work for
+// the ones they do not use and a new combination is only another entry in the list.
+
+typedef enum {
+    // color
+    OLIVEC_SHADE_FLAT = 0,
+    // c1, c2 and c3 mixed by the barycentric weights
+    OLIVEC_SHADE_COLORS,
+    // Bits of the interpolated z
+    OLIVEC_SHADE_Z,
+    // Nearest texel of near
+    OLIVEC_SHADE_NEAREST,
+    // olivec_pixel_bilinear() of near
+    OLIVEC_SHADE_BILINEAR,
+    // olivec_texture_sample_bilinear() of near and far blended by blend/256
+    OLIVEC_SHADE_TRILINEAR,
+    OLIVEC_SHADE_COUNT,
+} Olivec_Shade;
+
+typedef enum {
+    OLIVEC_WRITE_COPY = 0,
+    OLIVEC_WRITE_BLEND,
+    // olivec_blend_color_mode() with mode
+    OLIVEC_WRITE_MODE,
+    OLIVEC_WRITE_COUNT,
+} Olivec_Write;
+
+// Everything the variants may read, each one only looks at the fields of its features
+typedef struct {
+    Olivec_Canvas oc;
+    Olivec_Depth db;
+    // z plane for the depth test and OLIVEC_SHADE_Z, texture coordinates for the textured shades
+    Olivec_Uv uv;
+    uint32_t color;
+    uint32_t c1, c2, c3;
+    Olivec_Canvas near, far;
+    uint32_t blend;
+    Olivec_Blend_Mode mode;
+} Olivec_Raster;
+
+// Color of pixel i of the run starting at the barycentric weights u1 and u2 with the texture coordinates u and v
+static OLIVEC_ALWAYS_INLINE uint32_t olivec_raster_shade(const Olivec_Raster *r, const Olivec_Triangle *t, const Olivec_Shade shade,
+                                                         int u1, int u2, int i, const float *u, const float *v)
+{
+    switch (shade) {
+    case OLIVEC_SHADE_FLAT:
+        return r->color;
+    case OLIVEC_SHADE_COLORS:
+        return mix_colors3(r->c1, r->c2, r->c3, u1 + t->a[0]*i, u2 + t->a[1]*i, t->det);
+    case OLIVEC_SHADE_Z: {
+        float z = olivec_uv_z(&r->uv, u1, u2) + r->uv.dx[0]*i;
+        uint32_t bits;
+        memcpy(&bits, &z, sizeof(bits));
+        return bits;
+    }
+    case OLIVEC_SHADE_NEAREST: {
+        int texture_x = u[i]*r->near.width;
+        if (texture_x < 0) texture_x = 0;
+        if ((size_t) texture_x >= r->near.width) texture_x = r->near.width - 1;
+
+        int texture_y = v[i]*r->near.height;
+        if (texture_y < 0) texture_y = 0;
+        if ((size_t) texture_y >= r->near.height) texture_y = r->near.height - 1;
+        return OLIVEC_PIXEL(r->near, texture_x, texture_y);
+    }
+    case OLIVEC_SHADE_BILINEAR: {
+        float texture_x = u[i]*r->near.width;
+        if (texture_x < 0) texture_x = 0;
+        if (texture_x >= (float) r->near.width) texture_x = r->near.width - 1;
+
+        float texture_y = v[i]*r->near.height;
+        if (texture_y < 0) texture_y = 0;
+        if (texture_y >= (float) r->near.height) texture_y = r->near.height - 1;
+
+        int precision = 100;
+        return olivec_pixel_bilinear(r->near, texture_x*precision, texture_y*precision, precision, precision);
+    }
+    case OLIVEC_SHADE_TRILINEAR: {
+        uint32_t c = olivec_texture_sample_bilinear(r->near, u[i], v[i]);
+        if (r->blend > 0) c = olivec_lerp_color(c, olivec_texture_sample_bilinear(r->far, u[i], v[i]), r->blend);
+        return c;
+    }
+    default:
+        return 0;
+    }
+}
+
+// Walks the triangle in runs of up to OLIVEC_UV_SUBSPAN pixels: depth test, then the colors of the pixels that passed,
+// then the write. With a depth test, runs that are hidden entirely skip the texture coordinates and the texture reads.
+static OLIVEC_ALWAYS_INLINE void olivec_raster_spans(const Olivec_Raster *raster, Olivec_Triangle *t,
+                                                     const bool depth, const Olivec_Shade shade, const Olivec_Write write)
+{
+    // A local copy so the writes to the canvas can not alias the state
+    const Olivec_Raster r = *raster;
+    const bool textured = shade == OLIVEC_SHADE_NEAREST || shade == OLIVEC_SHADE_BILINEAR || shade == OLIVEC_SHADE_TRILINEAR;
+    int y, lx, hx, u1, u2;
+    float u[OLIVEC_UV_SUBSPAN], v[OLIVEC_UV_SUBSPAN];
+    uint32_t colors[OLIVEC_UV_SUBSPAN];
+    while (olivec_triangle_next_span(t, &y, &lx, &hx, &u1, &u2)) {
+        uint32_t *span = &OLIVEC_PIXEL(r.oc, 0, y);
+        if (!depth && shade == OLIVEC_SHADE_FLAT) {
+            if (write == OLIVEC_WRITE_BLEND) olivec_blend_span(&span[lx], r.color, hx - lx + 1);
+            else if (write == OLIVEC_WRITE_MODE) olivec_blend_span_mode(&span[lx], r.color, hx - lx + 1, r.mode);
+            else olivec_fill_span(&span[lx], r.color, hx - lx + 1);
+            continue;
+        }
+
+        for (int x0 = lx, n; x0 <= hx; x0 += n) {
+            n = olivec_uv_run(x0, hx);
+            int w1 = u1, w2 = u2;
+            u1 += t->a[0]*n;
+            u2 += t->a[1]*n;
+
+            uint64_t all = UINT64_MAX >> (64 - n);
+            uint64_t mask = all;
+            if (depth) {
+                mask = olivec_depth_test(r.db, x0, y, n, olivec_uv_z(&r.uv, w1, w2), r.uv.dx[0]);
+                if (mask == 0) continue;
+            }
+            if (textured) olivec_uv_span(&r.uv, x0, hx, w1, w2, u, v);
+
+            uint32_t *row = &span[x0];
+            if (write != OLIVEC_WRITE_COPY && mask == all) {
+                for (int i = 0; i < n; ++i) colors[i] = olivec_raster_shade(&r, t, shade, w1, w2, i, u, v);
+                if (write == OLIVEC_WRITE_BLEND) olivec_blend_span_pixels(row, colors, n);
+                else olivec_blend_span_pixels_mode(row, colors, n, r.mode);
+                continue;
+            }
+            for (int i = 0; i < n; ++i) {
+                if (depth && !(mask >> i&1)) continue;
+                uint32_t c = olivec_raster_shade(&r, t, shade, w1, w2, i, u, v);
+                if (write == OLIVEC_WRITE_BLEND) olivec_blend_color(&row[i], c);
+                else if (write == OLIVEC_WRITE_MODE) olivec_blend_color_mode(&row[i], c, r.mode);
+                else row[i] = c;
+            }
+        }
+    }
+}
+
+#define OLIVEC_RASTER_VARIANT(depth, shade, write) \
+    static void olivec_raster_##depth##_##shade##_##write(const Olivec_Raster *r, Olivec_Triangle *t) \
+    { \
+        olivec_raster_spans(r, t, depth, OLIVEC_SHADE_##shade, OLIVEC_WRITE_##write); \
+    }
+
+#define OLIVEC_RASTER_ENTRY(depth, shade, write) \
+    [depth][OLIVEC_WRITE_##write][OLIVEC_SHADE_##shade] = olivec_raster_##depth##_##shade##_##write,
+
+// Every combination of the depth test (0 or 1), the shades and the writes
+#define OLIVEC_RASTER_SHADES(X, depth, write) \
+    X(depth, FLAT, write) X(depth, COLORS, write) X(depth, Z, write) \
+    X(depth, NEAREST, write) X(depth, BILINEAR, write) X(depth, TRILINEAR, write)
+#define OLIVEC_RASTER_VARIANTS(X) \
+    OLIVEC_RASTER_SHADES(X, 0, COPY) OLIVEC_RASTER_SHADES(X, 0, BLEND) OLIVEC_RASTER_SHADES(X, 0, MODE) \
+    OLIVEC_RASTER_SHADES(X, 1, COPY) OLIVEC_RASTER_SHADES(X, 1, BLEND) OLIVEC_RASTER_SHADES(X, 1, MODE)
+
+OLIVEC_RASTER_VARIANTS(OLIVEC_RASTER_VARIANT)
+
+static void (*const olivec_rasterizers[2][OLIVEC_WRITE_COUNT][OLIVEC_SHADE_COUNT])(const Olivec_Raster *r, Olivec_Triangle *t) = {
+    OLIVEC_RASTER_VARIANTS(OLIVEC_RASTER_ENTRY)
+};
+
+static void olivec_raster_draw(const Olivec_Raster *r, Olivec_Triangle *t, bool depth, Olivec_Shade shade, Olivec_Write write)
+{
+    olivec_rasterizers[depth][write][shade](r, t);
+}
+
+OLIVECDEF void olivec_triangle3c(Olivec_Canvas oc, int x1, int y1, int x2, int y2, int x3, int y3,
+                                 uint32_t c1, uint32_t c2, uint32_t c3)
+{
+    Olivec_Triangle t;
+    if (!olivec_triangle_setup(&t, oc.width, oc.height, x1, y1, x2, y2, x3, y3)) return;
+
+    Olivec_Raster r = {.oc = oc, .c1 = c1, .c2 = c2, .c3 = c3};
+    olivec_raster_draw(&r, &t, false, OLIVEC_SHADE_COLORS, OLIVEC_WRITE_BLEND);
+}
+
+OLIVECDEF void olivec_triangle3c_mode(Olivec_Canvas oc, int x1, int y1, int x2, int y2, int x3, int y3,
+                                      uint32_t c1, uint32_t c2, uint32_t c3, Olivec_Blend_Mode mode)
+{
+    Olivec_Triangle t;
+    if (!olivec_triangle_setup(&t, oc.width, oc.height, x1, y1, x2, y2, x3, y3)) return;
+
+    Olivec_Raster r = {.oc = oc, .c1 = c1, .c2 = c2, .c3 = c3, .mode = mode};
+    olivec_raster_draw(&r, &t, false, OLIVEC_SHADE_COLORS, OLIVEC_WRITE_MODE);
+}
+
+OLIVECDEF void olivec_triangle_depth(Olivec_Canvas oc, Olivec_Depth db, int x1, int y1, int x2, int y2, int x3, int y3, float z1, float z2, float z3, uint32_t color)
+{
+    Olivec_Triangle t;
+    if (!olivec_triangle_setup_depth(&t, oc, db, x1, y1, x2, y2, x3, y3, z1, z2, z3)) return;
+
+    Olivec_Raster r = {.oc = oc, .db = db, .color = color};
+    olivec_uv_setup(&r.uv, &t, 0, 0, 0, 0, 0, 0, z1, z2, z3);
+    olivec_raster_draw(&r, &t, true, OLIVEC_SHADE_FLAT, OLIVEC_WRITE_BLEND);
+}
+
+OLIVECDEF void olivec_triangle3c_depth(Olivec_Canvas oc, Olivec_Depth db, int x1, int y1, int x2, int y2, int x3, int y3, float z1, float z2, float z3, uint32_t c1, uint32_t c2, uint32_t c3)
+{
+    Olivec_Triangle t;
+    if (!olivec_triangle_setup_depth(&t, oc, db, x1, y1, x2, y2, x3, y3, z1, z2, z3)) return;
+
+    Olivec_Raster r = {.oc = oc, .db = db, .c1 = c1, .c2 = c2, .c3 = c3};
+    olivec_uv_setup(&r.uv, &t, 0, 0, 0, 0, 0, 0, z1, z2, z3);
+    olivec_raster_draw(&r, &t, true, OLIVEC_SHADE_COLORS, OLIVEC_WRITE_BLEND);
+}
+
+OLIVECDEF void olivec_triangle3z(Olivec_Canvas oc, int x1, int y1, int x2, int y2, int x3, int y3, float z1, float z2, float z3)
+{
+    Olivec_Triangle t;
+    if (!olivec_triangle_setup(&t, oc.width, oc.height, x1, y1, x2, y2, x3, y3)) return;
+
+    Olivec_Raster r = {.oc = oc};
+    olivec_uv_setup(&r.uv, &t, 0, 0, 0, 0, 0, 0, z1, z2, z3);
+    olivec_raster_draw(&r, &t, false, OLIVEC_SHADE_Z, OLIVEC_WRITE_COPY);
+}
+
+// Textured triangle of a single level, db may be NULL
+static void olivec_triangle_texture(Olivec_Canvas oc, const Olivec_Depth *db, int x1, int y1, int x2, int y2, int x3, int y3, float tx1, float ty1, float tx2, float ty2, float tx3, float ty3, float z1, float z2, float z3, Olivec_Canvas texture, Olivec_Shade shade)
+{
+    Olivec_Triangle t;
+    if (db != NULL) {
+        if (!olivec_triangle_setup_depth(&t, oc, *db, x1, y1, x2, y2, x3, y3, z1, z2, z3)) return;
+    } else {
+        if (!olivec_triangle_setup(&t, oc.width, oc.height, x1, y1, x2, y2, x3, y3)) return;
+    }
+
+    Olivec_Raster r = {.oc = oc, .near = texture, .far = texture};
+    if (db != NULL) r.db = *db;
+    olivec_uv_setup(&r.uv, &t, tx1, ty1, tx2, ty2, tx3, ty3, z1, z2, z3);
+    olivec_raster_draw(&r, &t, db != NULL, shade, OLIVEC_WRITE_COPY);
+}
+
+OLIVECDEF void olivec_triangle3uv(Olivec_Canvas oc, int x1, int y1, int x2, int y2, int x3, int y3, float tx1, float ty1, float tx2, float ty2, float tx3, float ty3, float z1, float z2, float z3, Olivec_Canvas texture)
+{
+    olivec_triangle_texture(oc, NULL, x1, y1, x2, y2, x3, y3, tx1, ty1, tx2, ty2, tx3, ty3, z1, z2, z3, texture, OLIVEC_SHADE_NEAREST);
+}
+
+OLIVECDEF void olivec_triangle3uv_bilinear(Olivec_Canvas oc, int x1, int y1, int x2, int y2, int x3, int y3, float tx1, float ty1, float tx2, float ty2, float tx3, float ty3, float z1, float z2, float z3, Olivec_Canvas texture)
+{
+    olivec_triangle_texture(oc, NULL, x1, y1, x2, y2, x3, y3, tx1, ty1, tx2, ty2, tx3, ty3, z1, z2, z3, texture, OLIVEC_SHADE_BILINEAR);
+}
+
+OLIVECDEF void olivec_triangle3uv_depth(Olivec_Canvas oc, Olivec_Depth db, int x1, int y1, int x2, int y2, int x3, int y3, float tx1, float ty1, float tx2, float ty2, float tx3, float ty3, float z1, float z2, float z3, Olivec_Canvas texture)
+{
+    olivec_triangle_texture(oc, &db, x1, y1, x2, y2, x3, y3, tx1, ty1, tx2, ty2, tx3, ty3, z1, z2, z3, texture, OLIVEC_SHADE_NEAREST);
+}
+
+OLIVECDEF void olivec_triangle3uv_bilinear_depth(Olivec_Canvas oc, Olivec_Depth db, int x1, int y1, int x2, int y2, int x3, int y3, float tx1, float ty1, float tx2, float ty2, float tx3, float ty3, float z1, float z2, float z3, Olivec_Canvas texture)
+{
+    olivec_triangle_texture(oc, &db, x1, y1, x2, y2, x3, y3, tx1, ty1, tx2, ty2, tx3, ty3, z1, z2, z3, texture, OLIVEC_SHADE_BILINEAR);
+}
+
+// TODO: AA for triangle
+OLIVECDEF void olivec_triangle(Olivec_Canvas oc, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t color)
+{
+    Olivec_Triangle t;
+    if (!olivec_triangle_setup(&t, oc.width, oc.height, x1, y1, x2, y2, x3, y3)) return;
+
+    Olivec_Raster r = {.oc = oc, .color = color};
+    olivec_raster_draw(&r, &t, false, OLIVEC_SHADE_FLAT, OLIVEC_WRITE_BLEND);
+}
+
+OLIVECDEF void olivec_triangle_mode(Olivec_Canvas oc, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t color, Olivec_Blend_Mode mode)
+{
+    Olivec_Triangle t;
+    if (!olivec_triangle_setup(&t, oc.width, oc.height, x1, y1, x2, y2, x3, y3)) return;
+
+    Olivec_Raster r = {.oc = oc, .color = color, .mode = mode};
+    olivec_raster_draw(&r, &t, false, OLIVEC_SHADE_FLAT, OLIVEC_WRITE_MODE);
+}
+
+static inline int olivec_ctz64(uint64_t x)
+{
+#ifdef __GNUC__
+    return __builtin_ctzll(x);
+#else
+    int n = 0;
+    while (!(x&1)) {
+        x >>= 1;
+        n += 1;
+    }
+    return n;
+#endif
+}
+
+// Lit cells of a glyph row as a bit mask, bit x is the cell in column x
+static uint64_t olivec_font_row(Olivec_Font font, int glyph, size_t row)
+{
+    if (font.format == OLIVEC_FONT_BITS) {
+        size_t row_size = (font.width + 7)/8;
+        const uint8_t *bytes = (const uint8_t*) &font.glyphs[(glyph*font.height + row)*row_size];
+        uint64_t bits = 0;
+        for (size_t i = 0; i < row_size; ++i) bits |= (uint64_t) bytes[i] << (8*i);
+        return font.width < 64 ? bits&(((uint64_t) 1 << font.width) - 1) : bits;
+    }
+
+    const char *cells = &font.glyphs[(glyph*font.height + row)*font.width];
+    uint64_t bits = 0;
+    for (size_t x = 0; x < font.width; ++x) bits |= (uint64_t) (cells[x] != 0) << x;
+    return bits;
+}
+
+// Pops the lowest run of set bits off *bits
+static inline void olivec_next_run(uint64_t *bits, int *start, int *length)
+{
+    *start = olivec_ctz64(*bits);
+    uint64_t rest = *bits >> *start;
+    *length = rest == UINT64_MAX ? 64 - *start : olivec_ctz64(~rest);
+    *bits &= *length + *start >= 64 ? 0 : UINT64_MAX << (*start + *length);
+}
+
+OLIVECDEF void olivec_text(Olivec_Canvas oc, const char *text, int tx, int ty, Olivec_Font font, size_t glyph_size, uint32_t color)
+{
+    int glyph_width = (int) (font.width*glyph_size);
+    int glyph_height = (int) (font.height*glyph_size);
+    if (ty + glyph_height <= 0 || ty >= (int) oc.height) return;
+
+    for (size_t i = 0; *text; ++i, ++text) {
+        int gx = tx + i*font.width*glyph_size;
+        int gy = ty;
+        // Glyphs entirely outside of the canvas are skipped without looking at their cells
+        if (gx + glyph_width <= 0) continue;
+        if (gx >= (int) oc.width) break;
+
+        for (int dy = 0; (size_t) dy < font.height; ++dy) {
+            int py = gy + dy*glyph_size;
+            if (py + (int) glyph_size <= 0 || py >= (int) oc.height) continue;
+            // Horizontally adjacent lit cells never overlap, so every run of set bits is a single wider rect.
+            // Partially visible cells are clipped by olivec_rect() like anything else.
+            uint64_t bits = olivec_font_row(font, *text, dy);
+            while (bits) {
+                int start, length;
+                olivec_next_run(&bits, &start, &length);
+                olivec_rect(oc, gx + start*(int) glyph_size, py, length*(int) glyph_size, glyph_size, color);
+            }
+        }
+    }
+}
+
+// Exact incremental form of t*n/d for t, t + 1, t + 2, ... The quotient and the remainder are carried from pixel to
+// pixel, so there is no division per pixel and the result is still exactly what the division would give.
+typedef struct {
+    size_t q, r;
+    size_t dq, dr, d;
+} Olivec_Sprite_Step;
+
+static Olivec_Sprite_Step olivec_sprite_step(size_t t, size_t n, size_t d)
+{
+    return (Olivec_Sprite_Step) {.q = t*n/d, .r = t*n%d, .dq = n/d, .dr = n%d, .d = d};
+}
+
+static inline size_t olivec_sprite_step_next(Olivec_Sprite_Step *step)
+{
+    size_t q = step->q;
+    size_t r = step->r + step->dr;
+    bool carry = r >= step->d;
+    step->q += step->dq + carry;
+    step->r = carry ? r - step->d : r;
+    return q;
+}
+
+// The sprite functions run on chunks of rows with olivec_parallel_for()
+typedef struct {
+    Olivec_Canvas oc;
+    Olivec_Canvas sprite;
+    Olivec_Normalized_Rect nr;
+    // The corner of the destination rect that the sprite's origin is mapped to
+    int xa, ya;
+    int w, h;
+    // Source column of the first destination pixel of every row, which is nr.x1 or nr.x2 for flipped sprites.
+    // The column of x is (x - xa)*sprite.width/w, and since it is the same for every row it is set up only once.
+    Olivec_Sprite_Step columns;
+    Olivec_Blend_Mode mode;
+} Olivec_Sprite_Job;
+
+static bool olivec_sprite_job(Olivec_Sprite_Job *job, Olivec_Canvas oc, int x, int y, int w, int h, Olivec_Canvas sprite)
+{
+    if (sprite.width == 0) return false;
+    if (sprite.height == 0) return false;
+
+    // TODO: consider introducing flip parameter instead of relying on negative width and height
+    // Similar to how SDL_RenderCopyEx does that
+    Olivec_Normalized_Rect nr = {0};
+    if (!olivec_normalize_rect(x, y, w, h, oc.width, oc.height, &nr)) return false;
+
+    job->oc = oc;
+    job->sprite = sprite;
+    job->nr = nr;
+    job->xa = w < 0 ? nr.ox2 : nr.ox1;
+    job->ya = h < 0 ? nr.oy2 : nr.oy1;
+    job->w = w;
+    job->h = h;
+    job->mode = OLIVEC_BLEND_SRC_OVER;
+    if (w > 0) {
+        job->columns = olivec_sprite_step(nr.x1 - job->xa, sprite.width, w);
+    } else {
+        job->columns = olivec_sprite_step(job->xa - nr.x2, sprite.width, -w);
+    }
+    return true;
+}
+
+static void olivec_sprite_run(Olivec_Sprite_Job *job, Olivec_Parallel_Func *rows)
+{
+    size_t width = job->nr.x2 - job->nr.x1 + 1;
+    size_t height = job->nr.y2 - job->nr.y1 + 1;
+    olivec_parallel_for(height, olivec_row_grain(width), rows, job);
+}
+
+// Source columns of n consecutive destination pixels of a row, stepped from the state in *step, which is left at the
+// pixel after the last one. Flipped sprites step their columns from right to left (dir < 0), so columns is filled
+// backwards then.
+static void olivec_sprite_columns(Olivec_Sprite_Step *step, int dir, int n, uint32_t *columns)
+{
+    if (dir < 0) columns += n - 1;
+    for (int i = 0; i < n; ++i, columns += dir) *columns = (uint32_t) olivec_sprite_step_next(step);
+}
+
+static void olivec_sprite_blend_rows(void *user, size_t begin, size_t end)
+{
+    Olivec_Sprite_Job *job = user;
+    Olivec_Canvas oc = job->oc, sprite = job->sprite;
+    Olivec_Normalized_Rect nr = job->nr;
+    int xa = job->xa, ya = job->ya, w = job->w, h = job->h;
+    int dir = w < 0 ? -1 : 1;
+    int width = nr.x2 - nr.x1 + 1;
+
+    if (w == (int) sprite.width) {
+        for (int y = nr.y1 + (int) begin; y < nr.y1 + (int) end; ++y) {
+            size_t ny = (y - ya)*((int) sprite.height)/h;
+            olivec_blend_span_pixels_mode(&OLIVEC_PIXEL(oc, nr.x1, y), &OLIVEC_PIXEL(sprite, nr.x1 - xa, ny), width, job->mode);
+        }
+        return;
+    }
+
+    // The source columns are the same for every row, so they are stepped once per chunk of columns and every row
+    // is gathered into a small buffer through them
+    uint32_t columns[OLIVEC_SPAN_CHUNK];
+    uint32_t row[OLIVEC_SPAN_CHUNK];
+    Olivec_Sprite_Step step = job->columns;
+    for (int i = 0; i < width; i += OLIVEC_SPAN_CHUNK) {
+        int n = width - i;
+        if (n > OLIVEC_SPAN_CHUNK) n = OLIVEC_SPAN_CHUNK;
+        int x0 = dir > 0 ? nr.x1 + i : nr.x2 - i - n + 1;
+        olivec_sprite_columns(&step, dir, n, columns);
+        for (int y = nr.y1 + (int) begin; y < nr.y1 + (int) end; ++y) {
+            size_t ny = (y - ya)*((int) sprite.height)/h;
+            const uint32_t *src = &OLIVEC_PIXEL(sprite, 0, ny);
+            for (int k = 0; k < n; ++k) row[k] = src[columns[k]];
+            olivec_blend_span_pixels_mode(&OLIVEC_PIXEL(oc, x0, y), row, n, job->mode);
+        }
+    }
+}
+
+OLIVECDEF void olivec_sprite_blend(Olivec_Canvas oc, int x, int y, int w, int h, Olivec_Canvas sprite)
+{
+    olivec_sprite_blend_mode(oc, x, y, w, h, sprite, OLIVEC_BLEND_SRC_OVER);
+}
+
+OLIVECDEF void olivec_sprite_blend_mode(Olivec_Canvas oc, int x, int y, int w, int h, Olivec_Canvas sprite, Olivec_Blend_Mode mode)
+{
+    Olivec_Sprite_Job job;
+    if (!olivec_sprite_job(&job, oc, x, y, w, h, sprite)) return;
+    job.mode = mode;
+    olivec_sprite_run(&job, olivec_sprite_blend_rows);
+}
+
+static void olivec_sprite_copy_rows(void *user, size_t begin, size_t end)
+{
+    Olivec_Sprite_Job *job = user;
+    Olivec_Canvas oc = job->oc, sprite = job->sprite;
+    Olivec_Normalized_Rect nr = job->nr;
+    int xa = job->xa, ya = job->ya, w = job->w, h = job->h;
+    int dir = w < 0 ? -1 : 1;
+    int width = nr.x2 - nr.x1 + 1;
+
+    if (w == (int) sprite.width) {
+        // Unscaled and not flipped horizontally, every row is a straight copy
+        for (int y = nr.y1 + (int) begin; y < nr.y1 + (int) end; ++y) {
+            size_t ny = (y - ya)*((int) sprite.height)/h;
+            memcpy(&OLIVEC_PIXEL(oc, nr.x1, y), &OLIVEC_PIXEL(sprite, nr.x1 - xa, ny), width*sizeof(uint32_t));
+        }
+        return;
+    }
+
+    uint32_t columns[OLIVEC_SPAN_CHUNK];
+    Olivec_Sprite_Step step = job->columns;
+    for (int i = 0; i < width; i += OLIVEC_SPAN_CHUNK) {
+        int n = width - i;
+        if (n > OLIVEC_SPAN_CHUNK) n = OLIVEC_SPAN_CHUNK;
+        int x0 = dir > 0 ? nr.x1 + i : nr.x2 - i - n + 1;
+        olivec_sprite_columns(&step, dir, n, columns);
+        for (int y = nr.y1 + (int) begin; y < nr.y1 + (int) end; ++y) {
+            size_t ny = (y - ya)*((int) sprite.height)/h;
+            const uint32_t *src = &OLIVEC_PIXEL(sprite, 0, ny);
+            uint32_t *dst = &OLIVEC_PIXEL(oc, x0, y);
+            for (int k = 0; k < n; ++k) dst[k] = src[columns[k]];
+        }
+    }
+}
+
+OLIVECDEF void olivec_sprite_copy(Olivec_Canvas oc, int x, int y, int w, int h, Olivec_Canvas sprite)
+{
+    Olivec_Sprite_Job job;
+    if (olivec_sprite_job(&job, oc, x, y, w, h, sprite)) olivec_sprite_run(&job, olivec_sprite_copy_rows);
+}
+
+// TODO: olivec_pixel_bilinear does not check for out-of-bounds
+// But maybe it shouldn't. Maybe it's a responsibility of the caller of the function.
+OLIVECDEF uint32_t olivec_pixel_bilinear(Olivec_Canvas sprite, int nx, int ny, int w, int h)
+{
+    int px = nx%w;
+    int py = ny%h;
+
+    int x1 = nx/w, x2 = nx/w;
+    int y1 = ny/h, y2 = ny/h;
+    if (px < w/2) {
+        // left
+        px += w/2;
+        x1 -= 1;
+        if (x1 < 0) x1 = 0;
+    } else {
+        // right
+        px -= w/2;
+        x2 += 1;
+        if ((size_t) x2 >= sprite.width) x2 = sprite.width - 1;
+    }
+
+    if (py < h/2) {
+        // top
+        py += h/2;
+        y1 -= 1;
+        if (y1 < 0) y1 = 0;
+    } else {
+        // bottom
+        py -= h/2;
+        y2 += 1;
+        if ((size_t) y2 >= sprite.height) y2 = sprite.height - 1;
+    }
+
+    return mix_colors2(mix_colors2(OLIVEC_PIXEL(sprite, x1, y1),
+                                   OLIVEC_PIXEL(sprite, x2, y1),
+                                   px, w),
+                       mix_colors2(OLIVEC_PIXEL(sprite, x1, y2),
+                                   OLIVEC_PIXEL(sprite, x2, y2),
+                                   px, w),
+                       py, h);
+}
+
+// Destination pixel t of a scale from m pixels to n pixels samples the source at (t + 0.5)*m/n - 0.5, which keeps
+// the pixel centers aligned. The position is 8.8 fixed point: the integer part is the left (top) source pixel and
+// the fraction the weight of the one after it. Positions outside of the source are clamped to its edge pixels.
+static void olivec_bilinear_sample(size_t t, size_t n, size_t m, uint32_t *index, uint32_t *weight)
+{
+    int64_t s = (int64_t) ((2*(uint64_t) t + 1)*m*256/(2*n)) - 128;
+    if (s < 0) s = 0;
+    *index = (uint32_t) (s >> 8);
+    *weight = (uint32_t) (s&255);
+    if (m == 1) {
+        *index = 0;
+        *weight = 0;
+    } else if (*index >= m - 1) {
+        *index = (uint32_t) m - 2;
+        *weight = 256;
+    }
+}
+
+static void olivec_sprite_copy_bilinear_rows(void *user, size_t begin, size_t end)
+{
+    Olivec_Sprite_Job *job = user;
+    Olivec_Canvas oc = job->oc, sprite = job->sprite;
+    Olivec_Normalized_Rect nr = job->nr;
+    int w = job->w, h = job->h;
+    int width = nr.x2 - nr.x1 + 1;
+
+    // The columns and their weights are the same for every row, so they are set up once per chunk of columns
+    uint32_t columns[OLIVEC_SPAN_CHUNK];
+    uint32_t weights[OLIVEC_SPAN_CHUNK];
+    for (int i = 0; i < width; i += OLIVEC_SPAN_CHUNK) {
+        int n = width - i;
+        if (n > OLIVEC_SPAN_CHUNK) n = OLIVEC_SPAN_CHUNK;
+        for (int k = 0; k < n; ++k) {
+            uint32_t fx;
+            olivec_bilinear_sample(nr.x1 + i + k - nr.ox1, w, sprite.width, &columns[k], &fx);
+            weights[k] = fx << 16 | (256 - fx);
+        }
+
+        for (int y = nr.y1 + (int) begin; y < nr.y1 + (int) end; ++y) {
+            uint32_t y0, fy;
+            olivec_bilinear_sample(y - nr.oy1, h, sprite.height, &y0, &fy);
+            const uint32_t *r0 = &OLIVEC_PIXEL(sprite, 0, y0);
+            const uint32_t *r1 = sprite.height > 1 ? &OLIVEC_PIXEL(sprite, 0, y0 + 1) : r0;
+            // The kernel always reads the pixel after the left one
+            uint32_t p0[2], p1[2];
+            if (sprite.width == 1) {
+                p0[0] = p0[1] = r0[0];
+                p1[0] = p1[1] = r1[0];
+                r0 = p0;
+                r1 = p1;
+            }
+            olivec_kernels.bilinear_span(&OLIVEC_PIXEL(oc, nr.x1 + i, y), r0, r1, fy, columns, weights, n);
+        }
+    }
+}
+
+OLIVECDEF void olivec_sprite_copy_bilinear(Olivec_Canvas oc, int x, int y, int w, int h, Olivec_Canvas sprite)
+{
+    // TODO: support negative size in olivec_sprite_copy_bilinear()
+    if (w <= 0) return;
+    if (h <= 0) return;
+
+    Olivec_Sprite_Job job;
+    if (olivec_sprite_job(&job, oc, x, y, w, h, sprite)) olivec_sprite_run(&job, olivec_sprite_copy_bilinear_rows);
+}
+
+OLIVECDEF void olivec_scale_bilinear(Olivec_Canvas dst, Olivec_Canvas src)
+{
+    olivec_sprite_copy_bilinear(dst, 0, 0, dst.width, dst.height, src);
+}
+
+// Memory
+
+#ifndef OLIVEC_REALLOC
+#include <stdlib.h>
+#define OLIVEC_REALLOC realloc
+#endif
+
+#ifndef OLIVEC_FREE
+#include <stdlib.h>
+#define OLIVEC_FREE free
+#endif
+
+// Grows *items to at least n elements. On allocation failure the old buffer is kept and false is returned.
+static bool olivec_reserve(void **items, size_t *capacity, size_t n, size_t item_size)
+{
+    if (n <= *capacity) return true;
+    size_t new_capacity = *capacity ? *capacity : 64;
+    while (new_capacity < n) new_capacity *= 2;
+    void *new_items = OLIVEC_REALLOC(*items, new_capacity*item_size);
+    if (new_items == NULL) return false;
+    *items = new_items;
+    *capacity = new_capacity;
+    return true;
+}
+
+// Mipmapped textures
+
+// Every texel of the next level is the average of a 2x2 block of the previous one. Odd sizes clamp the block to the
+// edge, so the last row and column are not lost.
+static void olivec_texture_downsample(Olivec_Canvas dst, Olivec_Canvas src)
+{
+    for (size_t y = 0; y < dst.height; ++y) {
+        const uint32_t *r0 = &OLIVEC_PIXEL(src, 0, 2*y);
+        const uint32_t *r1 = &OLIVEC_PIXEL(src, 0, 2*y + 1 < src.height ? 2*y + 1 : 2*y);
+        for (size_t x = 0; x < dst.width; ++x) {
+            size_t x0 = 2*x, x1 = 2*x + 1 < src.width ? 2*x + 1 : 2*x;
+            uint32_t rb = (r0[x0]&0x00FF00FF) + (r0[x1]&0x00FF00FF) + (r1[x0]&0x00FF00FF) + (r1[x1]&0x00FF00FF);
+            uint32_t ga = ((r0[x0] >> 8)&0x00FF00FF) + ((r0[x1] >> 8)&0x00FF00FF) + ((r1[x0] >> 8)&0x00FF00FF) + ((r1[x1] >> 8)&0x00FF00FF);
+            OLIVEC_PIXEL(dst, x, y) = (((rb + 0x00020002) >> 2)&0x00FF00FF) | ((((ga + 0x00020002) >> 2)&0x00FF00FF) << 8);
+        }
+    }
+}
+
+OLIVECDEF bool olivec_texture_init(Olivec_Texture *texture, Olivec_Canvas canvas)
+{
+    *texture = (Olivec_Texture) {0};
+    if (canvas.width == 0 || canvas.height == 0) return false;
+
+    texture->levels[0] = canvas;
+    texture->count = 1;
+    size_t total = 0;
+    size_t w = canvas.width, h = canvas.height;
+    while ((w > 1 || h > 1) && texture->count < OLIVEC_MAX_MIP_LEVELS) {
+        w = w > 1 ? w/2 : 1;
+        h = h > 1 ? h/2 : 1;
+        // The pixels are only known once all the levels are counted
+        texture->levels[texture->count++] = (Olivec_Canvas) {NULL, w, h, w};
+        total += w*h;
+    }
+    if (total > 0) {
+        texture->pixels = OLIVEC_REALLOC(NULL, total*sizeof(*texture->pixels));
+        if (texture->pixels == NULL) {
+            texture->count = 1;
+            return false;
+        }
+    }
+    uint32_t *pixels = texture->pixels;
+    for (size_t i = 1; i < texture->count; ++i) {
+        texture->levels[i].pixels = pixels;
+        pixels += texture->levels[i].width*texture->levels[i].height;
+    }
+    olivec_texture_update(texture);
+    return true;
+}
+
+OLIVECDEF void olivec_texture_update(Olivec_Texture *texture)
+{
+    for (size_t i = 1; i < texture->count; ++i) olivec_texture_downsample(texture->levels[i], texture->levels[i - 1]);
+}
+
+OLIVECDEF void olivec_texture_free(Olivec_Texture *texture)
+{
+    OLIVEC_FREE(texture->pixels);
+    *texture = (Olivec_Texture) {0};
+}
+
+// log2(x) for x > 0 from the exponent of the float and a quadratic fit of the mantissa, within 0.01 of the exact
+// value, which is plenty to pick a mip level
+static float olivec_log2f(float x)
+{
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    float e = (float) ((int) ((bits >> 23)&0xFF) - 127);
+    float m = (float) (bits&0x7FFFFF)/(1 << 23);
+    return e + m*(1.3465f - 0.3465f*m);
+}
+
+// Picks the levels of the texture for a whole triangle, sets up its texture coordinates and returns the shade
+static Olivec_Shade olivec_texture_setup(Olivec_Raster *r, const Olivec_Texture *texture, Olivec_Mip_Filter filter, const Olivec_Triangle *t,
+                                         float tx1, float ty1, float tx2, float ty2, float tx3, float ty3, float z1, float z2, float z3)
+{
+    // One level for the whole triangle: half of log2 of the ratio between its area in texels and in pixels
+    float lod = 0;
+    if (z1 != 0 && z2 != 0 && z3 != 0) {
+        float w = texture->levels[0].width, h = texture->levels[0].height;
+        float u1 = tx1/z1*w, v1 = ty1/z1*h;
+        float u2 = tx2/z2*w, v2 = ty2/z2*h;
+        float u3 = tx3/z3*w, v3 = ty3/z3*h;
+        float texels = (u2 - u1)*(v3 - v1) - (u3 - u1)*(v2 - v1);
+        if (texels < 0) texels = -texels;
+        if (texels > t->det) lod = olivec_log2f(texels/t->det)/2;
+    }
+    float max_lod = (float) (texture->count - 1);
+    if (lod > max_lod) lod = max_lod;
+
+    olivec_uv_setup(&r->uv, t, tx1, ty1, tx2, ty2, tx3, ty3, z1, z2, z3);
+    if (filter == OLIVEC_MIP_NEAREST) {
+        r->near = r->far = texture->levels[(size_t) (lod + 0.5f)];
+        r->blend = 0;
+        return OLIVEC_SHADE_NEAREST;
+    }
+    size_t level = (size_t) lod;
+    r->near = texture->levels[level];
+    r->far = texture->levels[level + 1 < texture->count ? level + 1 : level];
+    r->blend = (uint32_t) ((lod - level)*256);
+    return OLIVEC_SHADE_TRILINEAR;
+}
+
+OLIVECDEF void olivec_triangle3uv_mip(Olivec_Canvas oc, int x1, int y1, int x2, int y2, int x3, int y3, float tx1, float ty1, float tx2, float ty2, float tx3, float ty3, float z1, float z2, float z3, const Olivec_Texture *texture, Olivec_Mip_Filter filter)
+{
+    if (texture->count == 0) return;
+    Olivec_Triangle t;
+    if (!olivec_triangle_setup(&t, oc.width, oc.height, x1, y1, x2, y2, x3, y3)) return;
+
+    Olivec_Raster r = {.oc = oc};
+    Olivec_Shade shade = olivec_texture_setup(&r, texture, filter, &t, tx1, ty1, tx2, ty2, tx3, ty3, z1, z2, z3);
+    olivec_raster_draw(&r, &t, false, shade, OLIVEC_WRITE_COPY);
+}
+
+OLIVECDEF void olivec_triangle3uv_mip_depth(Olivec_Canvas oc, Olivec_Depth db, int x1, int y1, int x2, int y2, int x3, int y3, float tx1, float ty1, float tx2, float ty2, float tx3, float ty3, float z1, float z2, float z3, const Olivec_Texture *texture, Olivec_Mip_Filter filter)
+{
+    if (texture->count == 0) return;
+    Olivec_Triangle t;
+    if (!olivec_triangle_setup_depth(&t, oc, db, x1, y1, x2, y2, x3, y3, z1, z2, z3)) return;
+
+    Olivec_Raster r = {.oc = oc, .db = db};
+    Olivec_Shade shade = olivec_texture_setup(&r, texture, filter, &t, tx1, ty1, tx2, ty2, tx3, ty3, z1, z2, z3);
+    olivec_raster_draw(&r, &t, true, shade, OLIVEC_WRITE_COPY);
+}
+
+// Strokes
+//
+// Geometry is in fixed point with OLIVEC_STROKE_ONE units per pixel and pixel (x, y) is sampled at (x, y). Every piece
+// of the stroke (segment quads, joins, caps) is convex, so it covers a single interval on every row. The pieces
+// produce spans with half-open [x1, x2) sample ranges, the spans are sorted by row and x, and the overlapping ones are
+// merged before blending.
+//
+// Points can be anywhere in the int range. Segments running far off the canvas are clipped before they are turned into
+// quads, and joins and caps too far away to touch the canvas are skipped, so the pieces stay within a few million
+// pixels of it. The products that involve the far away end points are exact while they fit into 64 bits and fall back
+// to double otherwise.
+
+#define OLIVEC_STROKE_ONE 256
+// Deltas up to this size are squared and multiplied by the half width in 64 bits
+#define OLIVEC_STROKE_EXACT ((int64_t) 1 << 30)
+
+static int64_t olivec_stroke_floor(double x)
+{
+    int64_t i = (int64_t) x;
+    return (double) i > x ? i - 1 : i;
+}
+
+// olivec_floor_div(a*b, c) without the overflow of a*b
+static int64_t olivec_stroke_mul_div(int64_t a, int64_t b, int64_t c)
+{
+    if (a == 0 || b == 0) return 0;
+    if ((a < 0 ? -a : a) <= INT64_MAX/(b < 0 ? -b : b)) return olivec_floor_div(a*b, c);
+    return olivec_stroke_floor((double) a*(double) b/(double) c);
+}
+
+typedef struct {
+    int y, x1, x2; // pixels x1..x2-1 of row y
+} Olivec_Stroke_Span;
+
+typedef struct {
+    Olivec_Canvas oc;
+    Olivec_Stroke_Span *spans;
+    size_t count;
+    size_t capacity;
+} Olivec_Stroker;
+
+static void olivec_stroke_span(Olivec_Stroker *sk, int y, int64_t x1, int64_t x2)
+{
+    // First and last pixel with its sample inside of [x1, x2]
+    int64_t px1 = olivec_ceil_div(x1, OLIVEC_STROKE_ONE);
+    int64_t px2 = olivec_ceil_div(x2, OLIVEC_STROKE_ONE);
+    if (px1 < 0) px1 = 0;
+    if (px2 > (int64_t) sk->oc.width) px2 = sk->oc.width;
+    if (px1 >= px2) return;
+    if (!olivec_reserve((void**) &sk->spans, &sk->capacity, sk->count + 1, sizeof(*sk->spans))) return;
+    sk->spans[sk->count++] = (Olivec_Stroke_Span) {y, (int) px1, (int) px2};
+}
+
+// Rows whose samples are inside of [y1, y2), clipped to the canvas
+static bool olivec_stroke_rows(const Olivec_Stroker *sk, int64_t y1, int64_t y2, int *ry1, int *ry2)
+{
+    int64_t py1 = olivec_ceil_div(y1, OLIVEC_STROKE_ONE);
+    int64_t py2 = olivec_ceil_div(y2, OLIVEC_STROKE_ONE);
+    if (py1 < 0) py1 = 0;
+    if (py2 > (int64_t) sk->oc.height) py2 = sk->oc.height;
+    *ry1 = (int) py1;
+    *ry2 = (int) py2;
+    return py1 < py2;
+}
+
+static void olivec_stroke_polygon(Olivec_Stroker *sk, const int64_t (*v)[2], size_t n)
+{
+    int64_t x1 = v[0][0], x2 = v[0][0];
+    int64_t y1 = v[0][1], y2 = v[0][1];
+    for (size_t i = 1; i < n; ++i) {
+        if (x1 > v[i][0]) x1 = v[i][0];
+        if (x2 < v[i][0]) x2 = v[i][0];
+        if (y1 > v[i][1]) y1 = v[i][1];
+        if (y2 < v[i][1]) y2 = v[i][1];
+    }
+    int ry1, ry2;
+    if (x2 < 0 || x1 >= (int64_t) sk->oc.width*OLIVEC_STROKE_ONE) return;
+    if (!olivec_stroke_rows(sk, y1, y2, &ry1, &ry2)) return;
+
+    for (int y = ry1; y < ry2; ++y) {
+        int64_t sy = (int64_t) y*OLIVEC_STROKE_ONE;
+        int64_t lx = INT64_MAX, hx = INT64_MIN;
+        for (size_t i = 0; i < n; ++i) {
+            const int64_t *a = v[i];
+            const int64_t *b = v[(i + 1)%n];
+            if ((sy < a[1] && sy < b[1]) || (sy > a[1] && sy > b[1])) continue;
+            int64_t x = a[1] == b[1] ? a[0] : a[0] + olivec_stroke_mul_div(b[0] - a[0], sy - a[1], b[1] - a[1]);
+            int64_t x_other = a[1] == b[1] ? b[0] : x;
+            if (lx > x) lx = x;
+            if (hx < x) hx = x;
+            if (lx > x_other) lx = x_other;
+            if (hx < x_other) hx = x_other;
+        }
+        if (lx <= hx) olivec_stroke_span(sk, y, lx, hx);
+    }
+}
+
+static void olivec_stroke_disc(Olivec_Stroker *sk, int64_t cx, int64_t cy, int64_t r)
+{
+    int ry1, ry2;
+    if (!olivec_stroke_rows(sk, cy - r, cy + r, &ry1, &ry2)) return;
+    for (int y = ry1; y < ry2; ++y) {
+        int64_t dy = (int64_t) y*OLIVEC_STROKE_ONE - cy;
+        if (dy*dy > r*r) continue;
+        int64_t half = olivec_isqrt((uint64_t) (r*r - dy*dy));
+        olivec_stroke_span(sk, y, cx - half, cx + half);
+    }
+}
+
+// Normal of the segment a->b pointing to its left with the length hw
+static void olivec_stroke_normal(const int64_t *a, const int64_t *b, int64_t hw, int64_t *n)
+{
+    int64_t dx = b[0] - a[0];
+    int64_t dy = b[1] - a[1];
+    if (-OLIVEC_STROKE_EXACT <= dx && dx <= OLIVEC_STROKE_EXACT && -OLIVEC_STROKE_EXACT <= dy && dy <= OLIVEC_STROKE_EXACT) {
+        int64_t len = olivec_isqrt((uint64_t) (dx*dx + dy*dy));
+        n[0] = olivec_floor_div(-dy*hw*2 + len, len*2);
+        n[1] = olivec_floor_div(dx*hw*2 + len, len*2);
+    } else {
+        double len = olivec_sqrt((double) dx*(double) dx + (double) dy*(double) dy);
+        n[0] = olivec_stroke_floor(-(double) dy*(double) hw/len + 0.5);
+        n[1] = olivec_stroke_floor((double) dx*(double) hw/len + 0.5);
+    }
+}
+
+// Sign of the cross product of the vectors (x1, y1) and (x2, y2)
+static int olivec_stroke_cross(int64_t x1, int64_t y1, int64_t x2, int64_t y2)
+{
+    if (-OLIVEC_STROKE_EXACT <= x1 && x1 <= OLIVEC_STROKE_EXACT && -OLIVEC_STROKE_EXACT <= y1 && y1 <= OLIVEC_STROKE_EXACT &&
+        -OLIVEC_STROKE_EXACT <= x2 && x2 <= OLIVEC_STROKE_EXACT && -OLIVEC_STROKE_EXACT <= y2 && y2 <= OLIVEC_STROKE_EXACT) {
+        int64_t cross = x1*y2 - y1*x2;
+        return (cross > 0) - (cross < 0);
+    }
+    double l = (double) x1*(double) y2, r = (double) y1*(double) x2;
+    return (l > r) - (l < r);
+}
+
+// Whether p is inside of the canvas grown by reach
+static bool olivec_stroke_near(const Olivec_Stroker *sk, int64_t reach, const int64_t *p)
+{
+    return -reach <= p[0] && p[0] <= ((int64_t) sk->oc.width - 1)*OLIVEC_STROKE_ONE + reach &&
+           -reach <= p[1] && p[1] <= ((int64_t) sk->oc.height - 1)*OLIVEC_STROKE_ONE + reach;
+}
+
+// Clips the segment a->b to the canvas grown by reach (Liang-Barsky). End points that are inside are kept as they are.
+static bool olivec_stroke_clip(const Olivec_Stroker *sk, int64_t reach, const int64_t *a, const int64_t *b, int64_t *ca, int64_t *cb)
+{
+    double lo = (double) -reach;
+    double hi[2] = {
+        (double) (((int64_t) sk->oc.width - 1)*OLIVEC_STROKE_ONE + reach),
+        (double) (((int64_t) sk->oc.height - 1)*OLIVEC_STROKE_ONE + reach),
+    };
+    double t0 = 0, t1 = 1;
+    for (int k = 0; k < 2; ++k) {
+        double d = (double) (b[k] - a[k]);
+        if (d == 0) {
+            if ((double) a[k] < lo || (double) a[k] > hi[k]) return false;
+            continue;
+        }
+        double u0 = (lo - (double) a[k])/d, u1 = (hi[k] - (double) a[k])/d;
+        if (u0 > u1) OLIVEC_SWAP(double, u0, u1);
+        if (t0 < u0) t0 = u0;
+        if (t1 > u1) t1 = u1;
+    }
+    if (t0 > t1) return false;
+    for (int k = 0; k < 2; ++k) {
+        ca[k] = t0 == 0 ? a[k] : a[k] + (int64_t) (t0*(double) (b[k] - a[k]));
+        cb[k] = t1 == 1 ? b[k] : a[k] + (int64_t) (t1*(double) (b[k] - a[k]));
+    }
+    return true;
+}
+
+static void olivec_stroke_cap(Olivec_Stroker *sk, const int64_t *p, const int64_t *n, int64_t dir, Olivec_Cap cap, int64_t hw)
+{
+    switch (cap) {
+    case OLIVEC_CAP_BUTT: break;
+    case OLIVEC_CAP_ROUND:
+        olivec_stroke_disc(sk, p[0], p[1], hw);
+        break;
+    case OLIVEC_CAP_SQUARE: {
+        // n rotated by 90 degrees is the direction of the segment, dir says which end this is
+        int64_t ux = dir*n[1], uy = -dir*n[0];
+        int64_t v[4][2] = {
+            {p[0] + n[0], p[1] + n[1]},
+            {p[0] + n[0] + ux, p[1] + n[1] + uy},
+            {p[0] - n[0] + ux, p[1] - n[1] + uy},
+            {p[0] - n[0], p[1] - n[1]},
+        };
+        olivec_stroke_polygon(sk, v, 4);
+    } break;
+    }
+}
+
+static void olivec_stroke_join(Olivec_Stroker *sk, const int64_t *a, const int64_t *v, const int64_t *b,
+                               const int64_t *n1, const int64_t *n2, Olivec_Join join, int64_t hw)
+{
+    int cross = olivec_stroke_cross(v[0] - a[0], v[1] - a[1], b[0] - v[0], b[1] - v[1]);
+    if (join == OLIVEC_JOIN_ROUND) {
+        olivec_stroke_disc(sk, v[0], v[1], hw);
+        return;
+    }
+    // Straight continuation or a full turn back, neither has an outer corner to fill
+    if (cross == 0) return;
+
+    // The outer side of the turn is the one the path turns away from
+    int64_t s = cross > 0 ? -1 : 1;
+    int64_t o1[2] = {v[0] + s*n1[0], v[1] + s*n1[1]};
+    int64_t o2[2] = {v[0] + s*n2[0], v[1] + s*n2[1]};
+
+    int64_t dot = n1[0]*n2[0] + n1[1]*n2[1];
+    // The tip is at v + s*(n1 + n2)*hw^2/(hw^2 + dot), its distance from v is hw*sqrt(2/(1 + dot/hw^2))
+    if (join == OLIVEC_JOIN_MITER && hw*hw + dot > 0 &&
+        2*hw*hw <= OLIVEC_MITER_LIMIT*OLIVEC_MITER_LIMIT*(hw*hw + dot)) {
+        int64_t tip[2] = {
+            v[0] + olivec_stroke_mul_div(s*(n1[0] + n2[0]), hw*hw, hw*hw + dot),
+            v[1] + olivec_stroke_mul_div(s*(n1[1] + n2[1]), hw*hw, hw*hw + dot),
+        };
+        int64_t quad[4][2] = {{v[0], v[1]}, {o1[0], o1[1]}, {tip[0], tip[1]}, {o2[0], o2[1]}};
+        olivec_stroke_polygon(sk, quad, 4);
+    } else {
+        int64_t triangle[3][2] = {{v[0], v[1]}, {o1[0], o1[1]}, {o2[0], o2[1]}};
+        olivec_stroke_polygon(sk, triangle, 3);
+    }
+}
+
+static void olivec_stroke_blend(Olivec_Stroker *sk, uint32_t color)
+{
+    size_t height = sk->oc.height;
+    size_t n = sk->count;
+    if (n == 0) return;
+
+    // Counting sort by row into the second half of the buffer, the row starts go after it
+    size_t starts_size = (height + 1)*sizeof(size_t);
+    size_t extra = (starts_size + sizeof(*sk->spans) - 1)/sizeof(*sk->spans);
+    if (!olivec_reserve((void**) &sk->spans, &sk->capacity, 2*n + extra, sizeof(*sk->spans))) return;
+    Olivec_Stroke_Span *sorted = &sk->spans[n];
+    size_t *start = (size_t*) &sk->spans[2*n];
+    for (size_t y = 0; y <= height; ++y) start[y] = 0;
+    for (size_t i = 0; i < n; ++i) start[sk->spans[i].y + 1] += 1;
+    for (size_t y = 0; y < height; ++y) start[y + 1] += start[y];
+    for (size_t i = 0; i < n; ++i) sorted[start[sk->spans[i].y]++] = sk->spans[i];
+
+    // start[y] is now the end of row y
+    size_t begin = 0;
+    for (size_t y = 0; y < height; ++y) {
+        size_t end = start[y];
+        Olivec_Stroke_Span *row = &sorted[begin];
+        size_t m = end - begin;
+        begin = end;
+        if (m == 0) continue;
+
+        // Shell sort by x1, rows usually have only a few spans but busy plots can pile up a lot of them
+        for (size_t gap = m/2; gap > 0; gap /= 2) {
+            for (size_t i = gap; i < m; ++i) {
+                Olivec_Stroke_Span span = row[i];
+                size_t j = i;
+                for (; j >= gap && row[j - gap].x1 > span.x1; j -= gap) row[j] = row[j - gap];
+                row[j] = span;
+            }
+        }
+
+        int x1 = row[0].x1, x2 = row[0].x2;
+        for (size_t i = 1; i <= m; ++i) {
+            if (i < m && row[i].x1 <= x2) {
+                if (x2 < row[i].x2) x2 = row[i].x2;
+                continue;
+            }
+            olivec_blend_span(&OLIVEC_PIXEL(sk->oc, x1, y), color, x2 - x1);
+            if (i < m) {
+                x1 = row[i].x1;
+                x2 = row[i].x2;
+            }
+        }
+    }
+}
+
+static void olivec_stroke_offset(Olivec_Canvas oc, const int *points, size_t count, int dx, int dy,
+                                 size_t thiccness, Olivec_Join join, Olivec_Cap cap, uint32_t color)
+{
+    if (count == 0 || thiccness == 0 || oc.width == 0 || oc.height == 0) return;
+    if (thiccness > OLIVEC_STROKE_MAX_THICCNESS) thiccness = OLIVEC_STROKE_MAX_THICCNESS;
+    Olivec_Stroker sk = {.oc = oc};
+    int64_t hw = (int64_t) thiccness*OLIVEC_STROKE_ONE/2;
+    // Square caps reach out hw*sqrt(2) from the points, miters up to OLIVEC_MITER_LIMIT*hw. The extra 2^20 pixels
+    // leave the strokes that stay anywhere near the canvas unclipped, so their geometry is exact.
+    int64_t reach = hw*(OLIVEC_MITER_LIMIT > 2 ? OLIVEC_MITER_LIMIT : 2) + ((int64_t) OLIVEC_STROKE_ONE << 20);
+
+    // Points in fixed point with the repeated ones dropped
+    int64_t (*p)[2] = OLIVEC_REALLOC(NULL, count*sizeof(*p));
+    if (p == NULL) return;
+    size_t n = 0;
+    for (size_t i = 0; i < count; ++i) {
+        int64_t x = ((int64_t) points[2*i] + dx)*OLIVEC_STROKE_ONE;
+        int64_t y = ((int64_t) points[2*i + 1] + dy)*OLIVEC_STROKE_ONE;
+        if (n > 0 && p[n - 1][0] == x && p[n - 1][1] == y) continue;
+        p[n][0] = x;
+        p[n][1] = y;
+        n += 1;
+    }
+
+    if (n == 1) {
+        // A single dot
+        if (cap == OLIVEC_CAP_ROUND) {
+            olivec_stroke_disc(&sk, p[0][0], p[0][1], hw);
+        } else if (cap == OLIVEC_CAP_SQUARE) {
+            int64_t v[4][2] = {
+                {p[0][0] - hw, p[0][1] - hw},
+                {p[0][0] + hw, p[0][1] - hw},
+                {p[0][0] + hw, p[0][1] + hw},
+                {p[0][0] - hw, p[0][1] + hw},
+            };
+            olivec_stroke_polygon(&sk, v, 4);
+        }
+    } else {
+        int64_t first[2], prev[2], normal[2];
+        for (size_t i = 0; i + 1 < n; ++i) {
+            olivec_stroke_normal(p[i], p[i + 1], hw, normal);
+            if (i == 0) {
+                first[0] = normal[0];
+                first[1] = normal[1];
+            } else if (olivec_stroke_near(&sk, reach, p[i])) {
+                olivec_stroke_join(&sk, p[i - 1], p[i], p[i + 1], prev, normal, join, hw);
+            }
+            int64_t a[2], b[2];
+            if (olivec_stroke_clip(&sk, reach, p[i], p[i + 1], a, b)) {
+                int64_t quad[4][2] = {
+                    {a[0] + normal[0], a[1] + normal[1]},
+                    {b[0] + normal[0], b[1] + normal[1]},
+                    {b[0] - normal[0], b[1] - normal[1]},
+                    {a[0] - normal[0], a[1] - normal[1]},
+                };
+                olivec_stroke_polygon(&sk, quad, 4);
+            }
+            prev[0] = normal[0];
+            prev[1] = normal[1];
+        }
+        if (olivec_stroke_near(&sk, reach, p[0])) olivec_stroke_cap(&sk, p[0], first, -1, cap, hw);
+        if (olivec_stroke_near(&sk, reach, p[n - 1])) olivec_stroke_cap(&sk, p[n - 1], prev, 1, cap, hw);
+    }
+
+    olivec_stroke_blend(&sk, color);
+    OLIVEC_FREE(sk.spans);
+    OLIVEC_FREE(p);
+}
+
+OLIVECDEF void olivec_stroke(Olivec_Canvas oc, const int *points, size_t count, size_t thiccness, Olivec_Join join, Olivec_Cap cap, uint32_t color)
+{
+    olivec_stroke_offset(oc, points, count, 0, 0, thiccness, join, cap, color);
+}
+
+OLIVECDEF void olivec_polyline(Olivec_Canvas oc, const int *points, size_t count, size_t thiccness, uint32_t color)
+{
+    olivec_stroke(oc, points, count, thiccness, OLIVEC_JOIN_MITER, OLIVEC_CAP_BUTT, color);
+}
+
+// Glyph cache
+
+static size_t olivec_glyph_hash(const char *glyphs, int glyph, size_t size)
+{
+    uint64_t h = (uint64_t) (uintptr_t) glyphs;
+    h ^= (uint64_t) (uint32_t) glyph*0x9E3779B97F4A7C15ull;
+    h ^= (uint64_t) size*0xC2B2AE3D27D4EB4Full;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 32;
+    return (size_t) h;
+}
+
+static bool olivec_glyph_matches(const Olivec_Glyph *g, Olivec_Font font, int glyph, size_t size)
+{
+    return g->font.glyphs == font.glyphs && g->font.width == font.width && g->font.height == font.height &&
+           g->font.format == font.format && g->glyph == glyph && g->size == size;
+}
+
+// Slot of the glyph or the empty slot where it belongs
+static size_t olivec_glyph_slot(const Olivec_Glyph_Cache *cache, Olivec_Font font, int glyph, size_t size)
+{
+    size_t mask = cache->capacity - 1;
+    size_t i = olivec_glyph_hash(font.glyphs, glyph, size)&mask;
+    while (cache->used[i] && !olivec_glyph_matches(&cache->glyphs[i], font, glyph, size)) i = (i + 1)&mask;
+    return i;
+}
+
+static bool olivec_glyph_cache_grow(Olivec_Glyph_Cache *cache)
+{
+    Olivec_Glyph_Cache grown = *cache;
+    grown.capacity = cache->capacity ? cache->capacity*2 : 256;
+    grown.glyphs = OLIVEC_REALLOC(NULL, grown.capacity*sizeof(*grown.glyphs));
+    grown.used = OLIVEC_REALLOC(NULL, grown.capacity*sizeof(*grown.used));
+    if (grown.glyphs == NULL || grown.used == NULL) {
+        OLIVEC_FREE(grown.glyphs);
+        OLIVEC_FREE(grown.used);
+        return false;
+    }
+    memset(grown.used, 0, grown.capacity*sizeof(*grown.used));
+    for (size_t i = 0; i < cache->capacity; ++i) {
+        if (!cache->used[i]) continue;
+        const Olivec_Glyph *g = &cache->glyphs[i];
+        size_t slot = olivec_glyph_slot(&grown, g->font, g->glyph, g->size);
+        grown.glyphs[slot] = *g;
+        grown.used[slot] = true;
+    }
+    OLIVEC_FREE(cache->glyphs);
+    OLIVEC_FREE(cache->used);
+    *cache = grown;
+    return true;
+}
+
+static bool olivec_glyph_rasterize(Olivec_Glyph_Cache *cache, Olivec_Glyph *g, Olivec_Font font, int glyph, size_t size)
+{
+    *g = (Olivec_Glyph) {.font = font, .glyph = glyph, .size = size};
+
+    // Crop to the lit cells
+    uint64_t columns = 0;
+    int cy1 = INT32_MAX, cy2 = -1;
+    for (int cy = 0; (size_t) cy < font.height; ++cy) {
+        uint64_t bits = olivec_font_row(font, glyph, cy);
+        if (bits == 0) continue;
+        columns |= bits;
+        if (cy1 > cy) cy1 = cy;
+        cy2 = cy;
+    }
+    if (columns == 0 || size == 0) return true;
+    int cx1 = olivec_ctz64(columns);
+    int cx2 = cx1;
+    while (cx2 < 63 && (columns >> (cx2 + 1))) cx2 += 1;
+
+    g->x = cx1*(int) size;
+    g->y = cy1*(int) size;
+    g->w = (cx2 - cx1 + 1)*(int) size;
+    g->h = (cy2 - cy1 + 1)*(int) size;
+    size_t n = (size_t) g->w*g->h;
+    if (!olivec_reserve((void**) &cache->masks, &cache->masks_capacity, cache->masks_count + n, sizeof(*cache->masks))) return false;
+    g->offset = cache->masks_count;
+    cache->masks_count += n;
+
+    uint8_t *mask = &cache->masks[g->offset];
+    for (int y = 0; y < g->h; ++y) {
+        uint64_t bits = olivec_font_row(font, glyph, cy1 + y/(int) size) >> cx1;
+        for (int x = 0; x < g->w; ++x) {
+            // 0 or 255 without a branch
+            mask[y*g->w + x] = (uint8_t) (0 - ((bits >> (x/(int) size))&1));
+        }
+    }
+    return true;
+}
+
+OLIVECDEF const Olivec_Glyph *olivec_glyph_cache_get(Olivec_Glyph_Cache *cache, Olivec_Font font, int glyph, size_t size)
+{
+    if (cache->capacity > 0) {
+        size_t slot = olivec_glyph_slot(cache, font, glyph, size);
+        if (cache->used[slot]) return &cache->glyphs[slot];
+    }
+
+    // Keep the table at most half full
+    if ((cache->count + 1)*2 > cache->capacity && !olivec_glyph_cache_grow(cache)) return NULL;
+    Olivec_Glyph g;
+    if (!olivec_glyph_rasterize(cache, &g, font, glyph, size)) return NULL;
+    size_t slot = olivec_glyph_slot(cache, font, glyph, size);
+    cache->glyphs[slot] = g;
+    cache->used[slot] = true;
+    cache->count += 1;
+    return &cache->glyphs[slot];
+}
+
+OLIVECDEF void olivec_glyph_cache_reset(Olivec_Glyph_Cache *cache)
+{
+    if (cache->capacity > 0) memset(cache->used, 0, cache->capacity*sizeof(*cache->used));
+    cache->count = 0;
+    cache->masks_count = 0;
+}
+
+OLIVECDEF void olivec_glyph_cache_free(Olivec_Glyph_Cache *cache)
+{
+    OLIVEC_FREE(cache->glyphs);
+    OLIVEC_FREE(cache->used);
+    OLIVEC_FREE(cache->masks);
+    *cache = (Olivec_Glyph_Cache) {0};
+}
+
+// Blends color through an alpha mask of w by h placed at (x, y). The mask is clipped up front, then every row is
+// split into runs of equal alpha that are blended as spans.
+static void olivec_mask_blend(Olivec_Canvas oc, const uint8_t *mask, int x, int y, int w, int h, uint32_t color)
+{
+    Olivec_Normalized_Rect nr = {0};
+    if (!olivec_normalize_rect(x, y, w, h, oc.width, oc.height, &nr)) return;
+
+    uint32_t alpha = OLIVEC_ALPHA(color);
+    for (int py = nr.y1; py <= nr.y2; ++py) {
+        const uint8_t *row = &mask[(py - nr.oy1)*w];
+        int px = nr.x1;
+        while (px <= nr.x2) {
+            uint8_t m = row[px - nr.ox1];
+            int end = px + 1;
+            while (end <= nr.x2 && row[end - nr.ox1] == m) end += 1;
+            if (m == 255) {
+                olivec_blend_span(&OLIVEC_PIXEL(oc, px, py), color, end - px);
+            } else if (m > 0) {
+                uint32_t a = OLIVEC_DIV255(alpha*m);
+                olivec_blend_span(&OLIVEC_PIXEL(oc, px, py), (color&0x00FFFFFF)|(a<<(3*8)), end - px);
+            }
+            px = end;
+        }
+    }
+}
+
+OLIVECDEF void olivec_text_cached(Olivec_Canvas oc, Olivec_Glyph_Cache *cache, const char *text, int tx, int ty, Olivec_Font font, size_t glyph_size, uint32_t color)
+{
+    int glyph_width = (int) (font.width*glyph_size);
+    int glyph_height = (int) (font.height*glyph_size);
+    if (ty + glyph_height <= 0 || ty >= (int) oc.height) return;
+
+    for (size_t i = 0; *text; ++i, ++text) {
+        int gx = tx + i*font.width*glyph_size;
+        if (gx + glyph_width <= 0) continue;
+        if (gx >= (int) oc.width) break;
+
+        const Olivec_Glyph *g = olivec_glyph_cache_get(cache, font, *text, glyph_size);
+        if (g == NULL) {
+            // Out of memory, draw the glyph without the cache
+            char single[2] = {*text, 0};
+            olivec_text(oc, single, gx, ty, font, glyph_size, color);
+            continue;
+        }
+        if (g->w > 0) olivec_mask_blend(oc, &cache->masks[g->offset], gx + g->x, ty + g->y, g->w, g->h, color);
+    }
+}
+
+// Outline fonts
+
+#define OLIVEC_TTF_TAG(a, b, c, d) ((uint32_t) (a) << 24 | (uint32_t) (b) << 16 | (uint32_t) (c) << 8 | (uint32_t) (d))
+
+// Big endian reads that return 0 outside of the font data instead of trusting the offsets in the file
+static uint32_t olivec_ttf_read(const Olivec_Outline_Font *font, size_t offset, size_t n)
+{
+    if (offset > font->size || n > font->size - offset) return 0;
+    uint32_t value = 0;
+    for (size_t i = 0; i < n; ++i) value = value << 8 | font->data[offset + i];
+    return value;
+}
+
+static inline uint8_t olivec_ttf_u8(const Olivec_Outline_Font *font, size_t offset)   { return (uint8_t) olivec_ttf_read(font, offset, 1); }
+static inline uint16_t olivec_ttf_u16(const Olivec_Outline_Font *font, size_t offset) { return (uint16_t) olivec_ttf_read(font, offset, 2); }
+static inline int16_t olivec_ttf_i16(const Olivec_Outline_Font *font, size_t offset)  { return (int16_t) olivec_ttf_read(font, offset, 2); }
+static inline uint32_t olivec_ttf_u32(const Olivec_Outline_Font *font, size_t offset) { return olivec_ttf_read(font, offset, 4); }
+
+OLIVECDEF bool olivec_outline_font_init(Olivec_Outline_Font *font, const void *data, size_t size)
+{
+    *font = (Olivec_Outline_Font) {.data = data, .size = size};
+
+    // Collections are read as their first font
+    uint32_t start = 0;
+    if (olivec_ttf_u32(font, 0) == OLIVEC_TTF_TAG('t', 't', 'c', 'f')) start = olivec_ttf_u32(font, 12);
+    uint32_t version = olivec_ttf_u32(font, start);
+    if (version != 0x00010000 && version != OLIVEC_TTF_TAG('t', 'r', 'u', 'e')) return false;
+
+    uint32_t head = 0, hhea = 0, maxp = 0;
+    uint32_t tables = olivec_ttf_u16(font, start + 4);
+    for (uint32_t i = 0; i < tables; ++i) {
+        size_t record = start + 12 + 16*i;
+        uint32_t offset = olivec_ttf_u32(font, record + 8);
+        switch (olivec_ttf_u32(font, record)) {
+        case OLIVEC_TTF_TAG('c', 'm', 'a', 'p'): font->cmap = offset; break;
+        case OLIVEC_TTF_TAG('g', 'l', 'y', 'f'): font->glyf = offset; break;
+        case OLIVEC_TTF_TAG('l', 'o', 'c', 'a'): font->loca = offset; break;
+        case OLIVEC_TTF_TAG('h', 'm', 't', 'x'): font->hmtx = offset; break;
+        case OLIVEC_TTF_TAG('h', 'e', 'a', 'd'): head = offset; break;
+        case OLIVEC_TTF_TAG('h', 'h', 'e', 'a'): hhea = offset; break;
+        case OLIVEC_TTF_TAG('m', 'a', 'x', 'p'): maxp = offset; break;
+        }
+    }
+    // Offset 0 is the font header, so it doubles as "missing"
+    if (!font->cmap || !font->glyf || !font->loca || !font->hmtx || !head || !hhea || !maxp) return false;
+
+    font->units_per_em = olivec_ttf_u16(font, head + 18);
+    if (font->units_per_em < 16 || font->units_per_em > 16384) return false;
+    font->x_min = olivec_ttf_i16(font, head + 36);
+    font->y_min = olivec_ttf_i16(font, head + 38);
+    font->x_max = olivec_ttf_i16(font, head + 40);
+    font->y_max = olivec_ttf_i16(font, head + 42);
+    font->long_loca = olivec_ttf_i16(font, head + 50) != 0;
+    font->ascent = olivec_ttf_i16(font, hhea + 4);
+    font->descent = olivec_ttf_i16(font, hhea + 6);
+    font->line_gap = olivec_ttf_i16(font, hhea + 8);
+    font->hmetric_count = olivec_ttf_u16(font, hhea + 34);
+    font->glyph_count = olivec_ttf_u16(font, maxp + 4);
+
+    // Prefer the full Unicode map (format 12) over the Basic Multilingual Plane one (format 4)
+    uint32_t cmap = font->cmap;
+    font->cmap = 0;
+    uint32_t encodings = olivec_ttf_u16(font, cmap + 2);
+    for (uint32_t i = 0; i < encodings; ++i) {
+        size_t record = cmap + 4 + 8*i;
+        uint16_t platform = olivec_ttf_u16(font, record);
+        uint16_t encoding = olivec_ttf_u16(font, record + 2);
+        uint32_t subtable = cmap + olivec_ttf_u32(font, record + 4);
+        bool unicode = platform == 0 || (platform == 3 && (encoding == 1 || encoding == 10));
+        if (!unicode) continue;
+        uint16_t format = olivec_ttf_u16(font, subtable);
+        if (format == 12) {
+            font->cmap = subtable;
+            font->cmap_format = 12;
+            break;
+        }
+        if (format == 4 && font->cmap_format != 4) {
+            font->cmap = subtable;
+            font->cmap_format = 4;
+        }
+    }
+    return font->cmap != 0;
+}
+
+OLIVECDEF int olivec_outline_font_glyph(const Olivec_Outline_Font *font, uint32_t codepoint)
+{
+    uint32_t t = font->cmap;
+    if (font->cmap_format == 12) {
+        // Binary search the sorted groups of consecutive codepoints
+        uint32_t lo = 0, hi = olivec_ttf_u32(font, t + 12);
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo)/2;
+            size_t group = t + 16 + 12*(size_t) mid;
+            if (codepoint < olivec_ttf_u32(font, group)) {
+                hi = mid;
+            } else if (codepoint > olivec_ttf_u32(font, group + 4)) {
+                lo = mid + 1;
+            } else {
+                uint32_t glyph = olivec_ttf_u32(font, group + 8) + (codepoint - olivec_ttf_u32(font, group));
+                return glyph < (uint32_t) font->glyph_count ? (int) glyph : 0;
+            }
+        }
+        return 0;
+    }
+
+    if (font->cmap_format == 4 && codepoint <= 0xFFFF) {
+        // Binary search the first segment that ends at or after the codepoint
+        size_t segments = olivec_ttf_u16(font, t + 6)/2;
+        size_t ends = t + 14;
+        size_t starts = ends + 2*segments + 2;
+        size_t deltas = starts + 2*segments;
+        size_t range_offsets = deltas + 2*segments;
+        size_t lo = 0, hi = segments;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo)/2;
+            if (olivec_ttf_u16(font, ends + 2*mid) < codepoint) lo = mid + 1;
+            else hi = mid;
+        }
+        if (lo == segments) return 0;
+        uint16_t start = olivec_ttf_u16(font, starts + 2*lo);
+        if (codepoint < start) return 0;
+        uint16_t delta = olivec_ttf_u16(font, deltas + 2*lo);
+        uint16_t range_offset = olivec_ttf_u16(font, range_offsets + 2*lo);
+        uint16_t glyph;
+        if (range_offset == 0) {
+            glyph = (uint16_t) (codepoint + delta);
+        } else {
+            glyph = olivec_ttf_u16(font, range_offsets + 2*lo + range_offset + 2*(codepoint - start));
+            if (glyph != 0) glyph = (uint16_t) (glyph + delta);
+        }
+        return glyph < font->glyph_count ? glyph : 0;
+    }
+
+    return 0;
+}
+
+// Advance width of the glyph in font units
+static int olivec_ttf_advance(const Olivec_Outline_Font *font, int glyph)
+{
+    if (font->hmetric_count == 0) return 0;
+    // Monospaced tails of the table only store the last advance once
+    if (glyph >= font->hmetric_count) glyph = font->hmetric_count - 1;
+    return olivec_ttf_u16(font, font->hmtx + 4*(size_t) glyph);
+}
+
+// Offset of the glyph description in the font data, false for glyphs without an outline
+static bool olivec_ttf_glyph_offset(const Olivec_Outline_Font *font, int glyph, uint32_t *offset)
+{
+    if (glyph < 0 || glyph >= font->glyph_count) return false;
+    uint32_t start, end;
+    if (font->long_loca) {
+        start = olivec_ttf_u32(font, font->loca + 4*(size_t) glyph);
+        end = olivec_ttf_u32(font, font->loca + 4*(size_t) glyph + 4);
+    } else {
+        start = 2*(uint32_t) olivec_ttf_u16(font, font->loca + 2*(size_t) glyph);
+        end = 2*(uint32_t) olivec_ttf_u16(font, font->loca + 2*(size_t) glyph + 2);
+    }
+    if (start >= end) return false;
+    *offset = font->glyf + start;
+    return true;
+}
+
+static bool olivec_outline_line(Olivec_Outline_Cache *cache, float x0, float y0, float x1, float y1)
+{
+    if (!olivec_reserve((void**) &cache->segments, &cache->segments_capacity, (cache->segments_count + 1)*4, sizeof(*cache->segments))) return false;
+    float *s = &cache->segments[cache->segments_count*4];
+    s[0] = x0;
+    s[1] = y0;
+    s[2] = x1;
+    s[3] = y1;
+    cache->segments_count += 1;
+    return true;
+}
+
+// Flattens a quadratic Bezier curve into lines. The amount of lines grows with the fourth root of the deviation of
+// the control point, which keeps the error below a fraction of a pixel.
+static bool olivec_outline_quad(Olivec_Outline_Cache *cache, float x0, float y0, float x1, float y1, float x2, float y2)
+{
+    float ddx = x0 - 2*x1 + x2;
+    float ddy = y0 - 2*y1 + y2;
+    float deviation = ddx*ddx + ddy*ddy;
+    if (deviation < 0.333f) return olivec_outline_line(cache, x0, y0, x2, y2);
+    int n = 1 + (int) olivec_isqrt(olivec_isqrt((uint64_t) (3*deviation)));
+    float px = x0, py = y0;
+    for (int i = 1; i <= n; ++i) {
+        float t = (float) i/n;
+        float u = 1 - t;
+        float x = u*u*x0 + 2*u*t*x1 + t*t*x2;
+        float y = u*u*y0 + 2*u*t*y1 + t*t*y2;
+        if (!olivec_outline_line(cache, px, py, x, y)) return false;
+        px = x;
+        py = y;
+    }
+    return true;
+}
+
+// Appends the outline of the glyph to cache->segments. The points are transformed into pixels by
+// x' = m[0]*x + m[2]*y + m[4], y' = m[1]*x + m[3]*y + m[5]. *components bounds the total amount of composite
+// components, so a malformed font that refers to its own glyphs can not keep this busy forever.
+static bool olivec_outline_segments(Olivec_Outline_Cache *cache, const Olivec_Outline_Font *font, int glyph, const float m[6], int *components)
+{
+    uint32_t g;
+    if (!olivec_ttf_glyph_offset(font, glyph, &g)) return true;
+    int contours = olivec_ttf_i16(font, g);
+
+    if (contours < 0) {
+        // Composite glyph, every component is another glyph placed with its own transform
+        enum {
+            ARG_1_AND_2_ARE_WORDS    = 0x0001,
+            ARGS_ARE_XY_VALUES       = 0x0002,
+            WE_HAVE_A_SCALE          = 0x0008,
+            MORE_COMPONENTS          = 0x0020,
+            WE_HAVE_AN_X_AND_Y_SCALE = 0x0040,
+            WE_HAVE_A_TWO_BY_TWO     = 0x0080,
+        };
+        size_t p = g + 10;
+        uint16_t flags;
+        do {
+            if (*components <= 0) return true;
+            *components -= 1;
+            flags = olivec_ttf_u16(font, p);
+            int component = olivec_ttf_u16(font, p + 2);
+            p += 4;
+            float e, f;
+            if (flags&ARG_1_AND_2_ARE_WORDS) {
+                e = olivec_ttf_i16(font, p);
+                f = olivec_ttf_i16(font, p + 2);
+                p += 4;
+            } else {
+                e = (int8_t) olivec_ttf_u8(font, p);
+                f = (int8_t) olivec_ttf_u8(font, p + 1);
+                p += 2;
+            }
+            // Components aligned by matching points are rare, they are placed at the origin
+            if (!(flags&ARGS_ARE_XY_VALUES)) e = f = 0;
+            float a = 1, b = 0, c = 0, d = 1;
+            if (flags&WE_HAVE_A_SCALE) {
+                a = d = olivec_ttf_i16(font, p)/16384.0f;
+                p += 2;
+            } else if (flags&WE_HAVE_AN_X_AND_Y_SCALE) {
+                a = olivec_ttf_i16(font, p)/16384.0f;
+                d = olivec_ttf_i16(font, p + 2)/16384.0f;
+                p += 4;
+            } else if (flags&WE_HAVE_A_TWO_BY_TWO) {
+                a = olivec_ttf_i16(font, p)/16384.0f;
+                b = olivec_ttf_i16(font, p + 2)/16384.0f;
+                c = olivec_ttf_i16(font, p + 4)/16384.0f;
+                d = olivec_ttf_i16(font, p + 6)/16384.0f;
+                p += 8;
+            }
+            float cm[6] = {
+                m[0]*a + m[2]*b, m[1]*a + m[3]*b,
+                m[0]*c + m[2]*d, m[1]*c + m[3]*d,
+                m[0]*e + m[2]*f + m[4], m[1]*e + m[3]*f + m[5],
+            };
+            if (!olivec_outline_segments(cache, font, component, cm, components)) return false;
+        } while (flags&MORE_COMPONENTS);
+        return true;
+    }
+
+    // Simple glyph: the flags, then all the x coordinates, then all the y coordinates, each packed on its own
+    enum {
+        ON_CURVE     = 0x01,
+        X_SHORT      = 0x02,
+        Y_SHORT      = 0x04,
+        REPEAT       = 0x08,
+        X_SAME       = 0x10, // or positive for short coordinates
+        Y_SAME       = 0x20,
+    };
+    size_t ends = g + 10;
+    size_t count = contours > 0 ? (size_t) olivec_ttf_u16(font, ends + 2*(contours - 1)) + 1 : 0;
+    if (count == 0) return true;
+    if (!olivec_reserve((void**) &cache->points, &cache->points_capacity, 3*count, sizeof(*cache->points))) return false;
+    int32_t *points = cache->points;
+
+    size_t p = ends + 2*contours;
+    p += 2 + olivec_ttf_u16(font, p);
+    for (size_t i = 0; i < count;) {
+        uint8_t flag = olivec_ttf_u8(font, p++);
+        size_t repeat = flag&REPEAT ? olivec_ttf_u8(font, p++) : 0;
+        for (size_t r = 0; r <= repeat && i < count; ++r) points[3*i++ + 2] = flag;
+    }
+    int32_t x = 0, y = 0;
+    for (size_t i = 0; i < count; ++i) {
+        int32_t flag = points[3*i + 2];
+        if (flag&X_SHORT) {
+            int32_t dx = olivec_ttf_u8(font, p++);
+            x += flag&X_SAME ? dx : -dx;
+        } else if (!(flag&X_SAME)) {
+            x += olivec_ttf_i16(font, p);
+            p += 2;
+        }
+        points[3*i] = x;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        int32_t flag = points[3*i + 2];
+        if (flag&Y_SHORT) {
+            int32_t dy = olivec_ttf_u8(font, p++);
+            y += flag&Y_SAME ? dy : -dy;
+        } else if (!(flag&Y_SAME)) {
+            y += olivec_ttf_i16(font, p);
+            p += 2;
+        }
+        points[3*i + 1] = y;
+    }
+
+#define OLIVEC_OUTLINE_X(i) (m[0]*points[3*(i)] + m[2]*points[3*(i) + 1] + m[4])
+#define OLIVEC_OUTLINE_Y(i) (m[1]*points[3*(i)] + m[3]*points[3*(i) + 1] + m[5])
+    size_t first = 0;
+    for (int contour = 0; contour < contours; ++contour) {
+        size_t last = olivec_ttf_u16(font, ends + 2*contour);
+        if (last < first || last >= count) break;
+
+        // Start at an on-curve point. Between two off-curve points there is an implied on-curve point halfway.
+        float sx, sy;
+        size_t from, to;
+        if (points[3*first + 2]&ON_CURVE) {
+            sx = OLIVEC_OUTLINE_X(first);
+            sy = OLIVEC_OUTLINE_Y(first);
+            from = first + 1;
+            to = last;
+        } else if (points[3*last + 2]&ON_CURVE) {
+            sx = OLIVEC_OUTLINE_X(last);
+            sy = OLIVEC_OUTLINE_Y(last);
+            from = first;
+            to = last - 1;
+        } else {
+            sx = (OLIVEC_OUTLINE_X(first) + OLIVEC_OUTLINE_X(last))/2;
+            sy = (OLIVEC_OUTLINE_Y(first) + OLIVEC_OUTLINE_Y(last))/2;
+            from = first;
+            to = last;
+        }
+
+        float px = sx, py = sy, cx = 0, cy = 0;
+        bool control = false;
+        for (size_t i = from; i <= to; ++i) {
+            float qx = OLIVEC_OUTLINE_X(i);
+            float qy = OLIVEC_OUTLINE_Y(i);
+            bool ok;
+            if (points[3*i + 2]&ON_CURVE) {
+                ok = control ? olivec_outline_quad(cache, px, py, cx, cy, qx, qy) : olivec_outline_line(cache, px, py, qx, qy);
+                px = qx;
+                py = qy;
+                control = false;
+            } else if (control) {
+                float mx = (cx + qx)/2, my = (cy + qy)/2;
+                ok = olivec_outline_quad(cache, px, py, cx, cy, mx, my);
+                px = mx;
+                py = my;
+                cx = qx;
+                cy = qy;
+            } else {
+                ok = true;
+                cx = qx;
+                cy = qy;
+                control = true;
+            }
+            if (!ok) return false;
+        }
+        bool ok = control ? olivec_outline_quad(cache, px, py, cx, cy, sx, sy) : olivec_outline_line(cache, px, py, sx, sy);
+        if (!ok) return false;
+        first = last + 1;
+    }
+#undef OLIVEC_OUTLINE_X
+#undef OLIVEC_OUTLINE_Y
+    return true;
+}
+
+// Adds the signed area that the line covers in every cell to the accumulation buffer a of width w. The coverage of
+// a pixel is the running sum of a up to it, so every line only touches the cells it crosses and filling the inside
+// of the shape is left to a single pass over the buffer afterwards. The line must be inside of [0, w]x[0, h].
+static void olivec_accumulate_line(float *a, int w, int h, float x0, float y0, float x1, float y1)
+{
+    if (y0 == y1) return;
+    float dir = 1;
+    if (y0 > y1) {
+        float t;
+        t = x0; x0 = x1; x1 = t;
+        t = y0; y0 = y1; y1 = t;
+        dir = -1;
+    }
+    float dxdy = (x1 - x0)/(y1 - y0);
+    float x = x0;
+    int yend = (int) y1;
+    if ((float) yend < y1) yend += 1;
+    if (yend > h) yend = h;
+    for (int y = (int) y0; y < yend; ++y) {
+        float *row = &a[(size_t) y*w];
+        float dy = (y + 1 < y1 ? y + 1 : y1) - (y > y0 ? y : y0);
+        float xnext = x + dxdy*dy;
+        float d = dy*dir;
+        float xl = x < xnext ? x : xnext;
+        float xr = x < xnext ? xnext : x;
+        int xli = (int) xl;
+        int xri = (int) xr;
+        if ((float) xri < xr) xri += 1;
+        if (xri <= xli + 1) {
+            // Within a single cell, split by the average x
+            float xm = (x + xnext)/2 - xli;
+            row[xli] += d - d*xm;
+            row[xli + 1] += d*xm;
+        } else {
+            // Across several cells, the covered area grows linearly in the middle and quadratically at the ends
+            float s = 1/(xr - xl);
+            float xlf = xl - xli;
+            float a0 = s*(1 - xlf)*(1 - xlf)/2;
+            float xrf = xr - xri + 1;
+            float am = s*xrf*xrf/2;
+            row[xli] += d*a0;
+            if (xri == xli + 2) {
+                row[xli + 1] += d*(1 - a0 - am);
+            } else {
+                float a1 = s*(1.5f - xlf);
+                row[xli + 1] += d*(a1 - a0);
+                for (int xi = xli + 2; xi < xri - 1; ++xi) row[xi] += d*s;
+                float a2 = a1 + (xri - xli - 3)*s;
+                row[xri - 1] += d*(1 - a2 - am);
+            }
+            row[xri] += d*am;
+        }
+        x = xnext;
+    }
+}
+
+static inline int olivec_floorf(float x)
+{
+    int i = (int) x;
+    return (float) i > x ? i - 1 : i;
+}
+
+static bool olivec_outline_rasterize(Olivec_Outline_Cache *cache, Olivec_Outline_Glyph *g, const Olivec_Outline_Font *font, uint32_t codepoint, size_t size)
+{
+    g->font = font;
+    g->codepoint = codepoint;
+    g->size = size;
+    g->x = g->y = g->w = g->h = 0;
+
+    int glyph = olivec_outline_font_glyph(font, codepoint);
+    float scale = (float) size/font->units_per_em;
+    g->advance = (int) (olivec_ttf_advance(font, glyph)*scale*65536 + 0.5f);
+
+    // Font units go up, pixels go down
+    float m[6] = {scale, 0, 0, -scale, 0, 0};
+    int components = 64;
+    cache->segments_count = 0;
+    if (!olivec_outline_segments(cache, font, glyph, m, &components)) return false;
+    if (cache->segments_count == 0) return true;
+
+    float *s = cache->segments;
+    float x1 = s[0], y1 = s[1], x2 = s[0], y2 = s[1];
+    for (size_t i = 0; i < cache->segments_count*4; i += 2) {
+        if (x1 > s[i]) x1 = s[i];
+        if (x2 < s[i]) x2 = s[i];
+        if (y1 > s[i + 1]) y1 = s[i + 1];
+        if (y2 < s[i + 1]) y2 = s[i + 1];
+    }
+    // Real glyphs stay within a few em, anything bigger comes from a malformed font
+    if (x2 - x1 > 4.0f*size + 2 || y2 - y1 > 4.0f*size + 2) return true;
+    g->x = olivec_floorf(x1);
+    g->y = olivec_floorf(y1);
+    g->w = olivec_floorf(x2) + 1 - g->x;
+    g->h = olivec_floorf(y2) + 1 - g->y;
+
+    // The lines may write one cell past the end of a row, which belongs to the next row and keeps the running sum
+    // right. Only the last row needs the extra cells.
+    size_t n = (size_t) g->w*g->h;
+    if (!olivec_reserve((void**) &cache->accumulator, &cache->accumulator_capacity, n + 2, sizeof(*cache->accumulator)) ||
+        !olivec_reserve((void**) &g->mask, &g->mask_capacity, n, sizeof(*g->mask))) {
+        g->w = 0;
+        return false;
+    }
+    float *a = cache->accumulator;
+    memset(a, 0, (n + 2)*sizeof(*a));
+    for (size_t i = 0; i < cache->segments_count; ++i, s += 4) {
+        olivec_accumulate_line(a, g->w, g->h, s[0] - g->x, s[1] - g->y, s[2] - g->x, s[3] - g->y);
+    }
+
+    // Nonzero winding, overlapping contours saturate instead of cancelling out
+    float coverage = 0;
+    for (size_t i = 0; i < n; ++i) {
+        coverage += a[i];
+        float c = coverage < 0 ? -coverage : coverage;
+        g->mask[i] = c >= 1 ? 255 : (uint8_t) (c*255 + 0.5f);
+    }
+    return true;
+}
+
+static size_t olivec_outline_hash(const Olivec_Outline_Font *font, uint32_t codepoint, size_t size)
+{
+    uint64_t h = (uint64_t) (uintptr_t) font;
+    h ^= (uint64_t) codepoint*0x9E3779B97F4A7C15ull;
+    h ^= (uint64_t) size*0xC2B2AE3D27D4EB4Full;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 32;
+    return (size_t) h;
+}
+
+// Slot of the glyph or the empty slot where it belongs
+static size_t olivec_outline_slot(const Olivec_Outline_Cache *cache, const Olivec_Outline_Font *font, uint32_t codepoint, size_t size)
+{
+    size_t mask = cache->slots_capacity - 1;
+    size_t i = olivec_outline_hash(font, codepoint, size)&mask;
+    while (cache->slots[i] >= 0) {
+        const Olivec_Outline_Glyph *g = &cache->glyphs[cache->slots[i]];
+        if (g->font == font && g->codepoint == codepoint && g->size == size) break;
+        i = (i + 1)&mask;
+    }
+    return i;
+}
+
+// Removes the glyph from the hash table. The following slots of the probe sequence are shifted back into the hole,
+// so lookups never need tombstones.
+static void olivec_outline_unhash(Olivec_Outline_Cache *cache, int32_t index)
+{
+    const Olivec_Outline_Glyph *g = &cache->glyphs[index];
+    if (g->font == NULL) return;
+    size_t mask = cache->slots_capacity - 1;
+    size_t hole = olivec_outline_slot(cache, g->font, g->codepoint, g->size);
+    if (cache->slots[hole] != index) return;
+    for (size_t i = (hole + 1)&mask; cache->slots[i] >= 0; i = (i + 1)&mask) {
+        const Olivec_Outline_Glyph *other = &cache->glyphs[cache->slots[i]];
+        size_t home = olivec_outline_hash(other->font, other->codepoint, other->size)&mask;
+        // Only move entries whose home is not cyclically within (hole, i]
+        if (((i - home)&mask) >= ((i - hole)&mask)) {
+            cache->slots[hole] = cache->slots[i];
+            hole = i;
+        }
+    }
+    cache->slots[hole] = -1;
+}
+
+static void olivec_outline_unlink(Olivec_Outline_Cache *cache, int32_t index)
+{
+    Olivec_Outline_Glyph *g = &cache->glyphs[index];
+    if (g->prev >= 0) cache->glyphs[g->prev].next = g->next;
+    else cache->newest = g->next;
+    if (g->next >= 0) cache->glyphs[g->next].prev = g->prev;
+    else cache->oldest = g->prev;
+}
+
+static void olivec_outline_link_newest(Olivec_Outline_Cache *cache, int32_t index)
+{
+    Olivec_Outline_Glyph *g = &cache->glyphs[index];
+    g->prev = -1;
+    g->next = cache->newest;
+    if (cache->newest >= 0) cache->glyphs[cache->newest].prev = index;
+    else cache->oldest = index;
+    cache->newest = index;
+}
+
+static bool olivec_outline_cache_init(Olivec_Outline_Cache *cache)
+{
+    if (cache->capacity == 0) cache->capacity = OLIVEC_OUTLINE_CACHE_CAPACITY;
+    if (cache->capacity > INT32_MAX/4) cache->capacity = INT32_MAX/4;
+    // Keep the table at most half full
+    size_t slots = 1;
+    while (slots < cache->capacity*2) slots *= 2;
+    cache->glyphs = OLIVEC_REALLOC(NULL, cache->capacity*sizeof(*cache->glyphs));
+    cache->slots = OLIVEC_REALLOC(NULL, slots*sizeof(*cache->slots));
+    if (cache->glyphs == NULL || cache->slots == NULL) {
+        OLIVEC_FREE(cache->glyphs);
+        OLIVEC_FREE(cache->slots);
+        cache->glyphs = NULL;
+        cache->slots = NULL;
+        return false;
+    }
+    cache->slots_capacity = slots;
+    olivec_outline_cache_reset(cache);
+    return true;
+}
+
+OLIVECDEF const Olivec_Outline_Glyph *olivec_outline_cache_get(Olivec_Outline_Cache *cache, const Olivec_Outline_Font *font, uint32_t codepoint, size_t size)
+{
+    if (cache->glyphs == NULL && !olivec_outline_cache_init(cache)) return NULL;
+
+    size_t slot = olivec_outline_slot(cache, font, codepoint, size);
+    int32_t index = cache->slots[slot];
+    if (index >= 0) {
+        if (cache->newest != index) {
+            olivec_outline_unlink(cache, index);
+            olivec_outline_link_newest(cache, index);
+        }
+        return &cache->glyphs[index];
+    }
+
+    if (cache->count < cache->capacity) {
+        index = (int32_t) cache->count++;
+        cache->glyphs[index].mask = NULL;
+        cache->glyphs[index].mask_capacity = 0;
+    } else {
+        // Recycle the least recently used glyph along with its mask buffer
+        index = cache->oldest;
+        olivec_outline_unhash(cache, index);
+        olivec_outline_unlink(cache, index);
+    }
+
+    Olivec_Outline_Glyph *g = &cache->glyphs[index];
+    if (!olivec_outline_rasterize(cache, g, font, codepoint, size)) {
+        // Keep the entry out of the table and first in line for recycling
+        g->font = NULL;
+        g->prev = cache->oldest;
+        g->next = -1;
+        if (cache->oldest >= 0) cache->glyphs[cache->oldest].next = index;
+        else cache->newest = index;
+        cache->oldest = index;
+        return NULL;
+    }
+    cache->slots[olivec_outline_slot(cache, font, codepoint, size)] = index;
+    olivec_outline_link_newest(cache, index);
+    return g;
+}
+
+OLIVECDEF void olivec_outline_cache_reset(Olivec_Outline_Cache *cache)
+{
+    // The mask buffers stay around to be reused
+    for (size_t i = 0; i < cache->count; ++i) cache->glyphs[i].font = NULL;
+    for (size_t i = 0; i < cache->slots_capacity; ++i) cache->slots[i] = -1;
+    cache->newest = -1;
+    cache->oldest = -1;
+    for (size_t i = 0; i < cache->count; ++i) olivec_outline_link_newest(cache, (int32_t) i);
+}
+
+OLIVECDEF void olivec_outline_cache_free(Olivec_Outline_Cache *cache)
+{
+    for (size_t i = 0; i < cache->count; ++i) OLIVEC_FREE(cache->glyphs[i].mask);
+    OLIVEC_FREE(cache->glyphs);
+    OLIVEC_FREE(cache->slots);
+    OLIVEC_FREE(cache->points);
+    OLIVEC_FREE(cache->segments);
+    OLIVEC_FREE(cache->accumulator);
+    *cache = (Olivec_Outline_Cache) {.capacity = cache->capacity};
+}
+
+// Decodes the next codepoint and advances *text past it. Malformed sequences decode to U+FFFD one byte at a time.
+static uint32_t olivec_utf8_next(const char **text)
+{
+    const uint8_t *s = (const uint8_t*) *text;
+    uint32_t c = s[0];
+    size_t n = c < 0x80 ? 0 : c >= 0xC2 && c < 0xE0 ? 1 : c >= 0xE0 && c < 0xF0 ? 2 : c >= 0xF0 && c < 0xF5 ? 3 : 4;
+    if (n == 4) {
+        *text += 1;
+        return 0xFFFD;
+    }
+    c &= 0x7F >> n;
+    for (size_t i = 1; i <= n; ++i) {
+        if ((s[i]&0xC0) != 0x80) {
+            *text += 1;
+            return 0xFFFD;
+        }
+        c = c << 6 | (s[i]&0x3F);
+    }
+    *text += n + 1;
+    return c;
+}
+
+OLIVECDEF void olivec_text_outline(Olivec_Canvas oc, Olivec_Outline_Cache *cache, const char *text, int tx, int ty, const Olivec_Outline_Font *font, size_t size, uint32_t color)
+{
+    if (font->units_per_em == 0 || size == 0) return;
+    float scale = (float) size/font->units_per_em;
+    int baseline = ty + (int) (font->ascent*scale + 0.5f);
+    // Skip lines that the font bounding box says are outside of the canvas
+    if (baseline - font->y_max*scale >= (float) oc.height + 1 || baseline - font->y_min*scale <= -1) return;
+
+    int64_t pen = (int64_t) tx*65536;
+    while (*text) {
+        uint32_t codepoint = olivec_utf8_next(&text);
+        int gx = (int) ((pen + 0x8000) >> 16);
+        if (gx + font->x_min*scale >= (float) oc.width + 1) break;
+
+        const Olivec_Outline_Glyph *g = olivec_outline_cache_get(cache, font, codepoint, size);
+        if (g == NULL) {
+            // Out of memory, leave a gap
+            int glyph = olivec_outline_font_glyph(font, codepoint);
+            pen += (int64_t) (olivec_ttf_advance(font, glyph)*scale*65536 + 0.5f);
+            continue;
+        }
+        if (g->w > 0) olivec_mask_blend(oc, g->mask, gx + g->x, baseline + g->y, g->w, g->h, color);
+        pen += g->advance;
+    }
+}
+
+// Meshes
+
+enum {
+    OLIVEC_OUT_LEFT   = 1 << 0,
+    OLIVEC_OUT_RIGHT  = 1 << 1,
+    OLIVEC_OUT_BOTTOM = 1 << 2,
+    OLIVEC_OUT_TOP    = 1 << 3,
+    OLIVEC_OUT_NEAR   = 1 << 4,
+    OLIVEC_OUT_FAR    = 1 << 5,
+};
+
+// A vertex of a triangle on its way to the rasterizer. x, y, z, w are in clip space, sx, sy on the screen.
+typedef struct {
+    float x, y, z, w;
+    float sx, sy, rw;
+    float u, v;
+    uint32_t color;
+} Olivec_Mesh_Vertex;
+
+// Clip space positions and screen positions of n vertices from first, one array per component
+static void olivec_mesh_transform(const Olivec_Mesh *mesh, const float *m, size_t first, size_t n, float width, float height,
+                                  float *x, float *y, float *z, float *w, float *sx, float *sy, float *rw, uint8_t *outcodes)
+{
+    float px[OLIVEC_MESH_BATCH], py[OLIVEC_MESH_BATCH], pz[OLIVEC_MESH_BATCH];
+    const float *positions = &mesh->positions[3*first];
+    for (size_t i = 0; i < n; ++i) {
+        px[i] = positions[3*i + 0];
+        py[i] = positions[3*i + 1];
+        pz[i] = positions[3*i + 2];
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        x[i] = m[0]*px[i] + m[1]*py[i] + m[2]*pz[i] + m[3];
+        y[i] = m[4]*px[i] + m[5]*py[i] + m[6]*pz[i] + m[7];
+        z[i] = m[8]*px[i] + m[9]*py[i] + m[10]*pz[i] + m[11];
+        w[i] = m[12]*px[i] + m[13]*py[i] + m[14]*pz[i] + m[15];
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        float g = OLIVEC_MESH_GUARD_BAND*w[i];
+        outcodes[i] = (x[i] < -g ? OLIVEC_OUT_LEFT : 0)
+                    | (x[i] > g ? OLIVEC_OUT_RIGHT : 0)
+                    | (y[i] < -g ? OLIVEC_OUT_BOTTOM : 0)
+                    | (y[i] > g ? OLIVEC_OUT_TOP : 0)
+                    | (z[i] < -w[i] || w[i] <= 0 ? OLIVEC_OUT_NEAR : 0)
+                    | (z[i] > w[i] ? OLIVEC_OUT_FAR : 0);
+        // Only used for the vertices with w > 0
+        rw[i] = w[i] > 0 ? 1/w[i] : 0;
+        sx[i] = (0.5f + 0.5f*x[i]*rw[i])*width;
+        sy[i] = (0.5f - 0.5f*y[i]*rw[i])*height;
+    }
+}
+
+// Signed distance of a clip space vertex to the plane of an outcode bit, negative outside
+static float olivec_mesh_distance(const Olivec_Mesh_Vertex *v, int plane)
+{
+    float g = OLIVEC_MESH_GUARD_BAND*v->w;
+    switch (plane) {
+    case OLIVEC_OUT_LEFT:   return g + v->x;
+    case OLIVEC_OUT_RIGHT:  return g - v->x;
+    case OLIVEC_OUT_BOTTOM: return g + v->y;
+    case OLIVEC_OUT_TOP:    return g - v->y;
+    case OLIVEC_OUT_NEAR:   return v->w + v->z;
+    default:                return v->w - v->z;
+    }
+}
+
+// Sutherland-Hodgman against one plane. Every plane adds at most one vertex to the convex polygon.
+static size_t olivec_mesh_clip(const Olivec_Mesh_Vertex *in, size_t n, Olivec_Mesh_Vertex *out, int plane)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const Olivec_Mesh_Vertex *a = &in[i], *b = &in[(i + 1)%n];
+        float da = olivec_mesh_distance(a, plane);
+        float db = olivec_mesh_distance(b, plane);
+        if (da >= 0) out[count++] = *a;
+        if ((da >= 0) != (db >= 0)) {
+            float t = da/(da - db);
+            Olivec_Mesh_Vertex *v = &out[count++];
+            v->x = a->x + (b->x - a->x)*t;
+            v->y = a->y + (b->y - a->y)*t;
+            v->z = a->z + (b->z - a->z)*t;
+            v->w = a->w + (b->w - a->w)*t;
+            v->u = a->u + (b->u - a->u)*t;
+            v->v = a->v + (b->v - a->v)*t;
+            v->color = olivec_lerp_color(a->color, b->color, (uint32_t) (t*256));
+        }
+    }
+    return count;
+}
+
+static void olivec_mesh_triangle(Olivec_Canvas oc, const Olivec_Depth *db, const Olivec_Mesh *mesh, const Olivec_Mesh_Style *style,
+                                 const Olivec_Mesh_Vertex *a, const Olivec_Mesh_Vertex *b, const Olivec_Mesh_Vertex *c)
+{
+    // Counter-clockwise with y going up is clockwise with y going down, which is a negative area
+    float area = (b->sx - a->sx)*(c->sy - a->sy) - (c->sx - a->sx)*(b->sy - a->sy);
+    if (style->cull == OLIVEC_CULL_BACK && area >= 0) return;
+    if (style->cull == OLIVEC_CULL_FRONT && area <= 0) return;
+
+    int x1 = olivec_floorf(a->sx + 0.5f), y1 = olivec_floorf(a->sy + 0.5f);
+    int x2 = olivec_floorf(b->sx + 0.5f), y2 = olivec_floorf(b->sy + 0.5f);
+    int x3 = olivec_floorf(c->sx + 0.5f), y3 = olivec_floorf(c->sy + 0.5f);
+    if (style->texture != NULL && mesh->uvs != NULL) {
+        if (db != NULL) {
+            olivec_triangle3uv_mip_depth(oc, *db, x1, y1, x2, y2, x3, y3,
+                                         a->u*a->rw, a->v*a->rw, b->u*b->rw, b->v*b->rw, c->u*c->rw, c->v*c->rw,
+                                         a->rw, b->rw, c->rw, style->texture, style->filter);
+        } else {
+            olivec_triangle3uv_mip(oc, x1, y1, x2, y2, x3, y3,
+                                   a->u*a->rw, a->v*a->rw, b->u*b->rw, b->v*b->rw, c->u*c->rw, c->v*c->rw,
+                                   a->rw, b->rw, c->rw, style->texture, style->filter);
+        }
+    } else if (mesh->colors != NULL) {
+        if (db != NULL) {
+            olivec_triangle3c_depth(oc, *db, x1, y1, x2, y2, x3, y3, a->rw, b->rw, c->rw, a->color, b->color, c->color);
+        } else {
+            olivec_triangle3c(oc, x1, y1, x2, y2, x3, y3, a->color, b->color, c->color);
+        }
+    } else {
+        if (db != NULL) {
+            olivec_triangle_depth(oc, *db, x1, y1, x2, y2, x3, y3, a->rw, b->rw, c->rw, style->color);
+        } else {
+            olivec_triangle(oc, x1, y1, x2, y2, x3, y3, style->color);
+        }
+    }
+}
+
+OLIVECDEF bool olivec_mesh(Olivec_Canvas oc, const Olivec_Depth *db, Olivec_Mesh_Cache *cache, const Olivec_Mesh *mesh, const float mvp[16], Olivec_Mesh_Style style)
+{
+    size_t n = mesh->vertex_count;
+    if (!olivec_reserve((void**) &cache->vertices, &cache->vertices_capacity, 7*n, sizeof(*cache->vertices))) return false;
+    if (!olivec_reserve((void**) &cache->outcodes, &cache->outcodes_capacity, n, sizeof(*cache->outcodes))) return false;
+
+    float *x = cache->vertices, *y = x + n, *z = y + n, *w = z + n;
+    float *sx = w + n, *sy = sx + n, *rw = sy + n;
+    uint8_t *outcodes = cache->outcodes;
+    for (size_t i = 0; i < n; i += OLIVEC_MESH_BATCH) {
+        size_t count = n - i < OLIVEC_MESH_BATCH ? n - i : OLIVEC_MESH_BATCH;
+        olivec_mesh_transform(mesh, mvp, i, count, oc.width, oc.height,
+                              &x[i], &y[i], &z[i], &w[i], &sx[i], &sy[i], &rw[i], &outcodes[i]);
+    }
+
+    for (size_t t = 0; t < mesh->triangle_count; ++t) {
+        const uint32_t *index = &mesh->indices[3*t];
+        if (index[0] >= n || index[1] >= n || index[2] >= n) continue;
+        int outside = outcodes[index[0]] & outcodes[index[1]] & outcodes[index[2]];
+        int crossing = outcodes[index[0]] | outcodes[index[1]] | outcodes[index[2]];
+        if (outside) continue;
+
+        // Room for the three vertices and one more per clipping plane
+        Olivec_Mesh_Vertex polygon[2][9];
+        for (int j = 0; j < 3; ++j) {
+            uint32_t k = index[j];
+            Olivec_Mesh_Vertex *v = &polygon[0][j];
+            *v = (Olivec_Mesh_Vertex) {x[k], y[k], z[k], w[k], sx[k], sy[k], rw[k], 0, 0, 0};
+            if (mesh->uvs != NULL) {
+                v->u = mesh->uvs[2*k + 0];
+                v->v = mesh->uvs[2*k + 1];
+            }
+            if (mesh->colors != NULL) v->color = mesh->colors[k];
+        }
+        if (!crossing) {
+            olivec_mesh_triangle(oc, db, mesh, &style, &polygon[0][0], &polygon[0][1], &polygon[0][2]);
+            continue;
+        }
+
+        size_t count = 3;
+        int in = 0;
+        for (int plane = 1; plane <= OLIVEC_OUT_FAR && count >= 3; plane <<= 1) {
+            if (!(crossing & plane)) continue;
+            count = olivec_mesh_clip(polygon[in], count, polygon[1 - in], plane);
+            in = 1 - in;
+        }
+        if (count < 3) continue;
+
+        // The near plane keeps w >= 0, only a vertex right at w = 0 can not be projected
+        bool visible = true;
+        for (size_t j = 0; j < count; ++j) {
+            Olivec_Mesh_Vertex *v = &polygon[in][j];
+            if (v->w <= 0) visible = false;
+            v->rw = v->w > 0 ? 1/v->w : 0;
+            v->sx = (0.5f + 0.5f*v->x*v->rw)*oc.width;
+            v->sy = (0.5f - 0.5f*v->y*v->rw)*oc.height;
+        }
+        if (!visible) continue;
+        for (size_t j = 1; j + 1 < count; ++j) {
+            olivec_mesh_triangle(oc, db, mesh, &style, &polygon[in][0], &polygon[in][j], &polygon[in][j + 1]);
+        }
+    }
+    return true;
+}
+
+OLIVECDEF void olivec_mesh_cache_free(Olivec_Mesh_Cache *cache)
+{
+    OLIVEC_FREE(cache->vertices);
+    OLIVEC_FREE(cache->outcodes);
+    *cache = (Olivec_Mesh_Cache) {0};
+}
+
+// Deferred rendering
+
+#define OLIVEC_CMD_PAYLOAD_SIZE(member) (offsetof(Olivec_Command, member) + sizeof(((Olivec_Command*)0)->member))
+
+// Amount of bytes of Olivec_Command that are actually used by the command of the given kind
+static size_t olivec_cmd_size(Olivec_Command_Kind kind)
+{
+    size_t size = sizeof(Olivec_Command);
+    switch (kind) {
+    case OLIVEC_CMD_FILL:                  size = OLIVEC_CMD_PAYLOAD_SIZE(fill);        break;
+    case OLIVEC_CMD_RECT:                  size = OLIVEC_CMD_PAYLOAD_SIZE(rect);        break;
+    case OLIVEC_CMD_FRAME:                 size = OLIVEC_CMD_PAYLOAD_SIZE(frame);       break;
+    case OLIVEC_CMD_CIRCLE:                size = OLIVEC_CMD_PAYLOAD_SIZE(circle);      break;
+    case OLIVEC_CMD_ELLIPSE:               size = OLIVEC_CMD_PAYLOAD_SIZE(ellipse);     break;
+    case OLIVEC_CMD_LINE:
+    case OLIVEC_CMD_LINE_AA:               size = OLIVEC_CMD_PAYLOAD_SIZE(line);        break;
+    case OLIVEC_CMD_STROKE:                size = OLIVEC_CMD_PAYLOAD_SIZE(stroke);      break;
+    case OLIVEC_CMD_TRIANGLE:
+    case OLIVEC_CMD_TRIANGLE3C:            size = OLIVEC_CMD_PAYLOAD_SIZE(triangle);    break;
+    case OLIVEC_CMD_TRIANGLE3Z:            size = OLIVEC_CMD_PAYLOAD_SIZE(triangle3z);  break;
+    case OLIVEC_CMD_TRIANGLE3UV:
+    case OLIVEC_CMD_TRIANGLE3UV_BILINEAR:  size = OLIVEC_CMD_PAYLOAD_SIZE(triangle3uv); break;
+    case OLIVEC_CMD_TRIANGLE3UV_MIP:       size = OLIVEC_CMD_PAYLOAD_SIZE(triangle3uv_mip); break;
+    case OLIVEC_CMD_TEXT:                  size = OLIVEC_CMD_PAYLOAD_SIZE(text);        break;
+    case OLIVEC_CMD_SPRITE_BLEND:
+    case OLIVEC_CMD_SPRITE_COPY:
+    case OLIVEC_CMD_SPRITE_COPY_BILINEAR:  size = OLIVEC_CMD_PAYLOAD_SIZE(sprite);      break;
+    }
+    // Keep the next command aligned
+    return (size + _Alignof(Olivec_Command) - 1)/_Alignof(Olivec_Command)*_Alignof(Olivec_Command);
+}
+
+static void olivec_cmd_push(Olivec_CommandList *cl, Olivec_Command c)
+{
+    size_t size = olivec_cmd_size(c.kind);
+    if (cl->data_count + size > UINT32_MAX) return;
+    if (!olivec_reserve((void**) &cl->data, &cl->data_capacity, cl->data_count + size, sizeof(*cl->data))) return;
+    if (!olivec_reserve((void**) &cl->order, &cl->order_capacity, cl->count + 1, sizeof(*cl->order))) return;
+    memcpy(&cl->data[cl->data_count], &c, size);
+    cl->order[cl->count++] = (uint32_t) cl->data_count;
+    cl->data_count += size;
+}
+
+OLIVECDEF void olivec_cmd_reset(Olivec_CommandList *cl)
+{
+    cl->data_count = 0;
+    cl->count = 0;
+    cl->strings_count = 0;
+    cl->points_count = 0;
+}
+
+OLIVECDEF void olivec_cmd_free(Olivec_CommandList *cl)
+{
+    OLIVEC_FREE(cl->data);
+    OLIVEC_FREE(cl->order);
+    OLIVEC_FREE(cl->strings);
+    OLIVEC_FREE(cl->points);
+    OLIVEC_FREE(cl->boxes);
+    *cl = (Olivec_CommandList) {0};
+}
+
+OLIVECDEF void olivec_cmd_get(const Olivec_CommandList *cl, size_t index, Olivec_Command *c)
+{
+    const uint8_t *stored = &cl->data[cl->order[index]];
+    Olivec_Command_Kind kind;
+    memcpy(&kind, stored + offsetof(Olivec_Command, kind), sizeof(kind));
+    memcpy(c, stored, olivec_cmd_size(kind));
+}
+
+// Overwrites the command at index in place. Only valid if it keeps its kind.
+static void olivec_cmd_set(Olivec_CommandList *cl, size_t index, const Olivec_Command *c)
+{
+    memcpy(&cl->data[cl->order[index]], c, olivec_cmd_size(c->kind));
+}
+
+OLIVECDEF void olivec_cmd_fill(Olivec_CommandList *cl, uint32_t color)
+{
+    olivec_cmd_push(cl, (Olivec_Command) {.kind = OLIVEC_CMD_FILL, .fill = {color}});
+}
+
+OLIVECDEF void olivec_cmd_rect(Olivec_CommandList *cl, int x, int y, int w, int h, uint32_t color)
+{
+    olivec_cmd_rect_mode(cl, x, y, w, h, color, OLIVEC_BLEND_SRC_OVER);
+}
+
+OLIVECDEF void olivec_cmd_rect_mode(Olivec_CommandList *cl, int x, int y, int w, int h, uint32_t color, Olivec_Blend_Mode mode)
+{
+    olivec_cmd_push(cl, (Olivec_Command) {.kind = OLIVEC_CMD_RECT, .rect = {x, y, w, h, color, mode}});
+}
+
+OLIVECDEF void olivec_cmd_frame(Olivec_CommandList *cl, int x, int y, int w, int h, size_t thiccness, uint32_t color)
+{
+    olivec_cmd_push(cl, (Olivec_Command) {.kind = OLIVEC_CMD_FRAME, .frame = {x, y, w, h, thiccness, color}});
+}
+
+OLIVECDEF void olivec_cmd_circle(Olivec_CommandList *cl, int cx, int cy, int r, uint32_t color)
+{
+    olivec_cmd_push(cl, (Olivec_Command) {.kind = OLIVEC_CMD_CIRCLE, .circle = {cx, cy, r, color}});
+}
+
+OLIVECDEF void olivec_cmd_ellipse(Olivec_CommandList *cl, int cx, int cy, int rx, int ry, uint32_t color)
+{
+    olivec_cmd_push(cl, (Olivec_Command) {.kind = OLIVEC_CMD_ELLIPSE, .ellipse = {cx, cy, rx, ry, color}});
+}
+
+OLIVECDEF void olivec_cmd_line(Olivec_CommandList *cl, int x1, int y1, int x2, int y2, uint32_t color)
+{
+    olivec_cmd_push(cl, (Olivec_Command) {.kind = OLIVEC_CMD_LINE, .line = {x1, y1, x2, y2, color}});
+}
+
+OLIVECDEF void olivec_cmd_line_aa(Olivec_CommandList *cl, int x1, int y1, int x2, int y2, uint32_t color)
+{
+    olivec_cmd_push(cl, (Olivec_Command) {.kind = OLIVEC_CMD_LINE_AA, .line = {x1, y1, x2, y2, color}});
+}
+
+OLIVECDEF void olivec_cmd_stroke(Olivec_CommandList *cl, const int *points, size_t count, size_t thiccness, Olivec_Join join, Olivec_Cap cap, uint32_t color)
+{
+    // The points are copied, the caller's buffer does not have to outlive the list
+    if (!olivec_reserve((void**) &cl->points, &cl->points_capacity, cl->points_count + 2*count, sizeof(*cl->points))) return;
+    memcpy(&cl->points[cl->points_count], points, 2*count*sizeof(*points));
+    olivec_cmd_push(cl, (Olivec_Command) {.kind = OLIVEC_CMD_STROKE, .stroke = {cl->points_count, count, thiccness, join, cap, color}});
+    cl->points_count += 2*count;
+}
+
+OLIVECDEF void olivec_cmd_polyline(Olivec_CommandList *cl, const int *points, size_t count, size_t thiccness, uint32_t color)
+{
+    olivec_cmd_stroke(cl, points, count, thiccness, OLIVEC_JOIN_MITER, OLIVEC_CAP_BUTT, color);
+}
+
+OLIVECDEF void olivec_cmd_triangle(Olivec_CommandList *cl, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t color)
+{
+    olivec_cmd_triangle_mode(cl, x1, y1, x2, y2, x3, y3, color, OLIVEC_BLEND_SRC_OVER);
+}
+
+OLIVECDEF void olivec_cmd_triangle_mode(Olivec_CommandList *cl, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t color, Olivec_Blend_Mode mode)
+{
+    olivec_cmd_push(cl, (Olivec_Command) {.kind = OLIVEC_CMD_TRIANGLE, .triangle = {x1, y1, x2, y2, x3, y3, color, color, color, mode}});
+}
+
+OLIVECDEF void olivec_cmd_triangle3c(Olivec_CommandList *cl, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t c1, uint32_t c2, uint32_t c3)
+{
+    olivec_cmd_triangle3c_mode(cl, x1, y1, x2, y2, x3, y3, c1, c2, c3, OLIVEC_BLEND_SRC_OVER);
+}
+
+OLIVECDEF void olivec_cmd_triangle3c_mode(Olivec_CommandList *cl, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t c1, uint32_t c2, uint32_t c3, Olivec_Blend_Mode mode)
+{
+    olivec_cmd_push(cl, (Olivec_Command) {.kind = OLIVEC_CMD_TRIANGLE3C, .triangle = {x1, y1, x2, y2, x3, y3, c1, c2, c3, mode}});
+}
+
+OLIVECDEF void olivec_cmd_triangle3z(Olivec_CommandList *cl, int x1, int y1, int x2, int y2, int x3, int y3, float z1, float z2, float z3)
+{
+    olivec_cmd_push(cl, (Olivec_Command) {.kind = OLIVEC_CMD_TRIANGLE3Z, .triangle3z = {x1, y1, x2, y2, x3, y3, z1, z2, z3}});
+}
+
+OLIVECDEF void olivec_cmd_triangle3uv(Olivec_CommandList *cl, int x1, int y1, int x2, int y2, int x3, int y3, float tx1, float ty1, float tx2, float ty2, float tx3, float ty3, float z1, float z2, float z3, Olivec_Canvas texture)
+{
+    olivec_cmd_push(cl, (Olivec_Command) {.kind = OLIVEC_CMD_TRIANGLE3UV, .triangle3uv = {x1, y1, x2, y2, x3, y3, tx1, ty1, tx2, ty2, tx3, ty3, z1, z2, z3, texture}});
+}
+
+OLIVECDEF void olivec_cmd_triangle3uv_bilinear(Olivec_CommandList *cl, int x1, int y1, int x2, int y2, int x3, int y3, float tx1, float ty1, float tx2, float ty2, float tx3, float ty3, float z1, float z2, float z3, Olivec_Canvas texture)
+{
+    olivec_cmd_push(cl, (Olivec_Command) {.kind = OLIVEC_CMD_TRIANGLE3UV_BILINEAR, .triangle3uv = {x1, y1, x2, y2, x3, y3, tx1, ty1, tx2, ty2, tx3, ty3, z1, z2, z3, texture}});
+}
+
+OLIVECDEF void olivec_cmd_triangle3uv_mip(Olivec_CommandList *cl, int x1, int y1, int x2, int y2, int x3, int y3, float tx1, float ty1, float tx2, float ty2, float tx3, float ty3, float z1, float z2, float z3, const Olivec_Texture *texture, Olivec_Mip_Filter filter)
+{
+    olivec_cmd_push(cl, (Olivec_Command) {.kind = OLIVEC_CMD_TRIANGLE3UV_MIP, .triangle3uv_mip = {x1, y1, x2, y2, x3, y3, tx1, ty1, tx2, ty2, tx3, ty3, z1, z2, z3, texture, filter}});
+}
+
+OLIVECDEF void olivec_cmd_text(Olivec_CommandList *cl, const char *text, int x, int y, Olivec_Font font, size_t size, uint32_t color)
+{
+    // The text is copied, the caller's buffer does not have to outlive the list
+    size_t n = strlen(text) + 1;
+    if (!olivec_reserve((void**) &cl->strings, &cl->strings_capacity, cl->strings_count + n, sizeof(*cl->strings))) return;
+    memcpy(&cl->strings[cl->strings_count], text, n);
+    olivec_cmd_push(cl, (Olivec_Command) {.kind = OLIVEC_CMD_TEXT, .text = {cl->strings_count, x, y, font, size, color}});
+    cl->strings_count += n;
+}
+
+OLIVECDEF void olivec_cmd_sprite_blend(Olivec_CommandList *cl, int x, int y, int w, int h, Olivec_Canvas sprite)
+{
+    olivec_cmd_sprite_blend_mode(cl, x, y, w, h, sprite, OLIVEC_BLEND_SRC_OVER);
+}
+
+OLIVECDEF void olivec_cmd_sprite_blend_mode(Olivec_CommandList *cl, int x, int y, int w, int h, Olivec_Canvas sprite, Olivec_Blend_Mode mode)
+{
+    olivec_cmd_push(cl, (Olivec_Command) {.kind = OLIVEC_CMD_SPRITE_BLEND, .sprite = {x, y, w, h, sprite, mode}});
+}
+
+OLIVECDEF void olivec_cmd_sprite_copy(Olivec_CommandList *cl, int x, int y, int w, int h, Olivec_Canvas sprite)
+{
+    olivec_cmd_push(cl, (Olivec_Command) {.kind = OLIVEC_CMD_SPRITE_COPY, .sprite = {x, y, w, h, sprite}});
+}
+
+OLIVECDEF void olivec_cmd_sprite_copy_bilinear(Olivec_CommandList *cl, int x, int y, int w, int h, Olivec_Canvas sprite)
+{
+    olivec_cmd_push(cl, (Olivec_Command) {.kind = OLIVEC_CMD_SPRITE_COPY_BILINEAR, .sprite = {x, y, w, h, sprite}});
+}
+
+// Draws the command onto oc with all of its coordinates shifted by (dx, dy)
+static void olivec_cmd_execute(const Olivec_CommandList *cl, const Olivec_Command *c, Olivec_Canvas oc, int dx, int dy)
+{
+    switch (c->kind) {
+    case OLIVEC_CMD_FILL:
+        olivec_fill(oc, c->fill.color);
+        break;
+    case OLIVEC_CMD_RECT:
+        olivec_rect_mode(oc, c->rect.x + dx, c->rect.y + dy, c->rect.w, c->rect.h, c->rect.color, c->rect.mode);
+        break;
+    case OLIVEC_CMD_FRAME:
+        olivec_frame(oc, c->frame.x + dx, c->frame.y + dy, c->frame.w, c->frame.h, c->frame.thiccness, c->frame.color);
+        break;
+    case OLIVEC_CMD_CIRCLE:
+        olivec_circle(oc, c->circle.cx + dx, c->circle.cy + dy, c->circle.r, c->circle.color);
+        break;
+    case OLIVEC_CMD_ELLIPSE:
+        olivec_ellipse(oc, c->ellipse.cx + dx, c->ellipse.cy + dy, c->ellipse.rx, c->ellipse.ry, c->ellipse.color);
+        break;
+    case OLIVEC_CMD_LINE:
+        olivec_line(oc, c->line.x1 + dx, c->line.y1 + dy, c->line.x2 + dx, c->line.y2 + dy, c->line.color);
+        break;
+    case OLIVEC_CMD_LINE_AA:
+        olivec_line_aa(oc, c->line.x1 + dx, c->line.y1 + dy, c->line.x2 + dx, c->line.y2 + dy, c->line.color);
+        break;
+    case OLIVEC_CMD_STROKE:
+        olivec_stroke_offset(oc, &cl->points[c->stroke.offset], c->stroke.count, dx, dy,
+                             c->stroke.thiccness, c->stroke.join, c->stroke.cap, c->stroke.color);
+        break;
+    case OLIVEC_CMD_TRIANGLE:
+        olivec_triangle_mode(oc,
+                             c->triangle.x1 + dx, c->triangle.y1 + dy,
+                             c->triangle.x2 + dx, c->triangle.y2 + dy,
+                             c->triangle.x3 + dx, c->triangle.y3 + dy,
+                             c->triangle.c1, c->triangle.mode);
+        break;
+    case OLIVEC_CMD_TRIANGLE3C:
+        olivec_triangle3c_mode(oc,
+                               c->triangle.x1 + dx, c->triangle.y1 + dy,
+                               c->triangle.x2 + dx, c->triangle.y2 + dy,
+                               c->triangle.x3 + dx, c->triangle.y3 + dy,
+                               c->triangle.c1, c->triangle.c2, c->triangle.c3, c->triangle.mode);
+        break;
+    case OLIVEC_CMD_TRIANGLE3Z:
+        olivec_triangle3z(oc,
+                          c->triangle3z.x1 + dx, c->triangle3z.y1 + dy,
+                          c->triangle3z.x2 + dx, c->triangle3z.y2 + dy,
+                          c->triangle3z.x3 + dx, c->triangle3z.y3 + dy,
+                          c->triangle3z.z1, c->triangle3z.z2, c->triangle3z.z3);
+        break;
+    case OLIVEC_CMD_TRIANGLE3UV:
+    case OLIVEC_CMD_TRIANGLE3UV_BILINEAR: {
+        void (*triangle)(Olivec_Canvas, int, int, int, int, int, int, float, float, float, float, float, float, float, float, float, Olivec_Canvas) =
+            c->kind == OLIVEC_CMD_TRIANGLE3UV ? olivec_triangle3uv : olivec_triangle3uv_bilinear;
+        triangle(oc,
+                 c->triangle3uv.x1 + dx, c->triangle3uv.y1 + dy,
+                 c->triangle3uv.x2 + dx, c->triangle3uv.y2 + dy,
+                 c->triangle3uv.x3 + dx, c->triangle3uv.y3 + dy,
+                 c->triangle3uv.tx1, c->triangle3uv.ty1,
+                 c->triangle3uv.tx2, c->triangle3uv.ty2,
+                 c->triangle3uv.tx3, c->triangle3uv.ty3,
+                 c->triangle3uv.z1, c->triangle3uv.z2, c->triangle3uv.z3,
+                 c->triangle3uv.texture);
+    } break;
+    case OLIVEC_CMD_TRIANGLE3UV_MIP:
+        olivec_triangle3uv_mip(oc,
+                               c->triangle3uv_mip.x1 + dx, c->triangle3uv_mip.y1 + dy,
+                               c->triangle3uv_mip.x2 + dx, c->triangle3uv_mip.y2 + dy,
+                               c->triangle3uv_mip.x3 + dx, c->triangle3uv_mip.y3 + dy,
+                               c->triangle3uv_mip.tx1, c->triangle3uv_mip.ty1,
+                               c->triangle3uv_mip.tx2, c->triangle3uv_mip.ty2,
+                               c->triangle3uv_mip.tx3, c->triangle3uv_mip.ty3,
+                               c->triangle3uv_mip.z1, c->triangle3uv_mip.z2, c->triangle3uv_mip.z3,
+                               c->triangle3uv_mip.texture, c->triangle3uv_mip.filter);
+        break;
+    case OLIVEC_CMD_TEXT:
+        olivec_text(oc, &cl->strings[c->text.offset], c->text.x + dx, c->text.y + dy, c->text.font, c->text.size, c->text.color);
+        break;
+    case OLIVEC_CMD_SPRITE_BLEND:
+        olivec_sprite_blend_mode(oc, c->sprite.x + dx, c->sprite.y + dy, c->sprite.w, c->sprite.h, c->sprite.sprite, c->sprite.mode);
+        break;
+    case OLIVEC_CMD_SPRITE_COPY:
+        olivec_sprite_copy(oc, c->sprite.x + dx, c->sprite.y + dy, c->sprite.w, c->sprite.h, c->sprite.sprite);
+        break;
+    case OLIVEC_CMD_SPRITE_COPY_BILINEAR:
+        olivec_sprite_copy_bilinear(oc, c->sprite.x + dx, c->sprite.y + dy, c->sprite.w, c->sprite.h, c->sprite.sprite);
+        break;
+    }
+}
+
+static int olivec_bounds_clamp(int64_t x)
+{
+    return x < INT32_MIN ? INT32_MIN : x > INT32_MAX ? INT32_MAX : (int) x;
+}
+
+static void olivec_bounds_add(int *x1, int *y1, int *x2, int *y2, int x, int y)
+{
+    if (*x1 > x) *x1 = x;
+    if (*x2 < x) *x2 = x;
+    if (*y1 > y) *y1 = y;
+    if (*y2 < y) *y2 = y;
+}
+
+// Conservative bounding box x1..x2, y1..y2 of all the pixels the command may touch, clipped to width x height.
+static bool olivec_cmd_bounds(const Olivec_CommandList *cl, const Olivec_Command *c, size_t width, size_t height, int *x1, int *y1, int *x2, int *y2)
+{
+    *x1 = *y1 = INT32_MAX;
+    *x2 = *y2 = INT32_MIN;
+    switch (c->kind) {
+    case OLIVEC_CMD_FILL:
+        *x1 = 0;
+        *y1 = 0;
+        *x2 = (int) width - 1;
+        *y2 = (int) height - 1;
+        break;
+    case OLIVEC_CMD_RECT:
+        olivec_bounds_add(x1, y1, x2, y2, c->rect.x, c->rect.y);
+        olivec_bounds_add(x1, y1, x2, y2, c->rect.x + c->rect.w, c->rect.y + c->rect.h);
+        break;
+    case OLIVEC_CMD_FRAME: {
+        int t = (int) c->frame.thiccness;
+        olivec_bounds_add(x1, y1, x2, y2, c->frame.x - t, c->frame.y - t);
+        olivec_bounds_add(x1, y1, x2, y2, c->frame.x + c->frame.w + t, c->frame.y + c->frame.h + t);
+        olivec_bounds_add(x1, y1, x2, y2, c->frame.x + t, c->frame.y + t);
+        olivec_bounds_add(x1, y1, x2, y2, c->frame.x + c->frame.w - t, c->frame.y + c->frame.h - t);
+    } break;
+    case OLIVEC_CMD_CIRCLE: {
+        int r = OLIVEC_ABS(int, c->circle.r) + 1;
+        olivec_bounds_add(x1, y1, x2, y2, c->circle.cx - r, c->circle.cy - r);
+        olivec_bounds_add(x1, y1, x2, y2, c->circle.cx + r, c->circle.cy + r);
+    } break;
+    case OLIVEC_CMD_ELLIPSE: {
+        int rx = OLIVEC_ABS(int, c->ellipse.rx) + 1;
+        int ry = OLIVEC_ABS(int, c->ellipse.ry) + 1;
+        olivec_bounds_add(x1, y1, x2, y2, c->ellipse.cx - rx, c->ellipse.cy - ry);
+        olivec_bounds_add(x1, y1, x2, y2, c->ellipse.cx + rx, c->ellipse.cy + ry);
+    } break;
+    case OLIVEC_CMD_LINE:
+        olivec_bounds_add(x1, y1, x2, y2, c->line.x1, c->line.y1);
+        olivec_bounds_add(x1, y1, x2, y2, c->line.x2, c->line.y2);
+        break;
+    case OLIVEC_CMD_LINE_AA:
+        // The second pixel of every step can be one past the end points
+        olivec_bounds_add(x1, y1, x2, y2, c->line.x1 - 1, c->line.y1 - 1);
+        olivec_bounds_add(x1, y1, x2, y2, c->line.x2 + 1, c->line.y2 + 1);
+        olivec_bounds_add(x1, y1, x2, y2, c->line.x1 + 1, c->line.y1 + 1);
+        olivec_bounds_add(x1, y1, x2, y2, c->line.x2 - 1, c->line.y2 - 1);
+        break;
+    case OLIVEC_CMD_STROKE: {
+        if (c->stroke.count == 0) return false;
+        // Square caps reach out hw*sqrt(2) from the points, miters up to OLIVEC_MITER_LIMIT*hw
+        size_t t = c->stroke.thiccness < OLIVEC_STROKE_MAX_THICCNESS ? c->stroke.thiccness : OLIVEC_STROKE_MAX_THICCNESS;
+        int64_t ext = ((int64_t) t/2 + 1)*(c->stroke.join == OLIVEC_JOIN_MITER ? OLIVEC_MITER_LIMIT : 2) + 1;
+        const int *points = &cl->points[c->stroke.offset];
+        for (size_t i = 0; i < c->stroke.count; ++i) {
+            olivec_bounds_add(x1, y1, x2, y2, olivec_bounds_clamp(points[2*i] - ext), olivec_bounds_clamp(points[2*i + 1] - ext));
+            olivec_bounds_add(x1, y1, x2, y2, olivec_bounds_clamp(points[2*i] + ext), olivec_bounds_clamp(points[2*i + 1] + ext));
+        }
+    } break;
+    case OLIVEC_CMD_TRIANGLE:
+    case OLIVEC_CMD_TRIANGLE3C:
+        olivec_bounds_add(x1, y1, x2, y2, c->triangle.x1, c->triangle.y1);
+        olivec_bounds_add(x1, y1, x2, y2, c->triangle.x2, c->triangle.y2);
+        olivec_bounds_add(x1, y1, x2, y2, c->triangle.x3, c->triangle.y3);
+        break;
+    case OLIVEC_CMD_TRIANGLE3Z:
+        olivec_bounds_add(x1, y1, x2, y2, c->triangle3z.x1, c->triangle3z.y1);
+        olivec_bounds_add(x1, y1, x2, y2, c->triangle3z.x2, c->triangle3z.y2);
+        olivec_bounds_add(x1, y1, x2, y2, c->triangle3z.x3, c->triangle3z.y3);
+        break;
+    case OLIVEC_CMD_TRIANGLE3UV:
+    case OLIVEC_CMD_TRIANGLE3UV_BILINEAR:
+        olivec_bounds_add(x1, y1, x2, y2, c->triangle3uv.x1, c->triangle3uv.y1);
+        olivec_bounds_add(x1, y1, x2, y2, c->triangle3uv.x2, c->triangle3uv.y2);
+        olivec_bounds_add(x1, y1, x2, y2, c->triangle3uv.x3, c->triangle3uv.y3);
+        break;
+    case OLIVEC_CMD_TRIANGLE3UV_MIP:
+        olivec_bounds_add(x1, y1, x2, y2, c->triangle3uv_mip.x1, c->triangle3uv_mip.y1);
+        olivec_bounds_add(x1, y1, x2, y2, c->triangle3uv_mip.x2, c->triangle3uv_mip.y2);
+        olivec_bounds_add(x1, y1, x2, y2, c->triangle3uv_mip.x3, c->triangle3uv_mip.y3);
+        break;
+    case OLIVEC_CMD_TEXT: {
+        size_t n = strlen(&cl->strings[c->text.offset]);
+        if (n == 0) return false;
+        olivec_bounds_add(x1, y1, x2, y2, c->text.x, c->text.y);
+        olivec_bounds_add(x1, y1, x2, y2,
+                          c->text.x + (int) (n*c->text.font.width*c->text.size),
+                          c->text.y + (int) (c->text.font.height*c->text.size));
+    } break;
+    case OLIVEC_CMD_SPRITE_BLEND:
+    case OLIVEC_CMD_SPRITE_COPY:
+    case OLIVEC_CMD_SPRITE_COPY_BILINEAR:
+        olivec_bounds_add(x1, y1, x2, y2, c->sprite.x, c->sprite.y);
+        olivec_bounds_add(x1, y1, x2, y2, c->sprite.x + c->sprite.w, c->sprite.y + c->sprite.h);
+        break;
+    }
+
+    if (*x1 < 0) *x1 = 0;
+    if (*y1 < 0) *y1 = 0;
+    if (*x2 >= (int) width) *x2 = (int) width - 1;
+    if (*y2 >= (int) height) *y2 = (int) height - 1;
+    return *x1 <= *x2 && *y1 <= *y2;
+}
+
+OLIVECDEF void olivec_cmd_replay(const Olivec_CommandList *cl, Olivec_Canvas oc)
+{
+    for (size_t i = 0; i < cl->count; ++i) {
+        Olivec_Command c;
+        olivec_cmd_get(cl, i, &c);
+        olivec_cmd_execute(cl, &c, oc, 0, 0);
+    }
+}
+
+// Everything that has to match for two commands to be drawn with the same state
+static bool olivec_cmd_same_state(const Olivec_Command *a, const Olivec_Command *b)
+{
+    if (a->kind != b->kind) return false;
+    switch (a->kind) {
+    case OLIVEC_CMD_FILL:     return a->fill.color == b->fill.color;
+    case OLIVEC_CMD_RECT:     return a->rect.color == b->rect.color && a->rect.mode == b->rect.mode;
+    case OLIVEC_CMD_FRAME:    return a->frame.color == b->frame.color;
+    case OLIVEC_CMD_CIRCLE:   return a->circle.color == b->circle.color;
+    case OLIVEC_CMD_ELLIPSE:  return a->ellipse.color == b->ellipse.color;
+    case OLIVEC_CMD_LINE:
+    case OLIVEC_CMD_LINE_AA:  return a->line.color == b->line.color;
+    case OLIVEC_CMD_STROKE:   return a->stroke.color == b->stroke.color;
+    case OLIVEC_CMD_TRIANGLE: return a->triangle.c1 == b->triangle.c1 && a->triangle.mode == b->triangle.mode;
+    case OLIVEC_CMD_TEXT:     return a->text.color == b->text.color && a->text.font.glyphs == b->text.font.glyphs;
+    case OLIVEC_CMD_TRIANGLE3UV:
+    case OLIVEC_CMD_TRIANGLE3UV_BILINEAR:
+        return a->triangle3uv.texture.pixels == b->triangle3uv.texture.pixels;
+    case OLIVEC_CMD_TRIANGLE3UV_MIP:
+        return a->triangle3uv_mip.texture == b->triangle3uv_mip.texture && a->triangle3uv_mip.filter == b->triangle3uv_mip.filter;
+    case OLIVEC_CMD_SPRITE_BLEND:
+    case OLIVEC_CMD_SPRITE_COPY:
+    case OLIVEC_CMD_SPRITE_COPY_BILINEAR:
+        return a->sprite.sprite.pixels == b->sprite.sprite.pixels && a->sprite.mode == b->sprite.mode;
+    case OLIVEC_CMD_TRIANGLE3C:
+        return a->triangle.mode == b->triangle.mode;
+    case OLIVEC_CMD_TRIANGLE3Z:
+        return true;
+    }
+    return false;
+}
+
+static bool olivec_boxes_overlap(const int *a, const int *b)
+{
+    return a[0] <= b[2] && b[0] <= a[2] && a[1] <= b[3] && b[1] <= a[3];
+}
+
+// How far back olivec_cmd_sort() looks for a command with the same state
+#ifndef OLIVEC_CMD_SORT_WINDOW
+#define OLIVEC_CMD_SORT_WINDOW 64
+#endif
+
+OLIVECDEF void olivec_cmd_sort(Olivec_CommandList *cl)
+{
+    if (cl->count < 3) return;
+    if (!olivec_reserve((void**) &cl->boxes, &cl->boxes_capacity, cl->count*4, sizeof(*cl->boxes))) return;
+
+    // The list may be replayed into any canvas, so the boxes are only clipped against the positive quadrant.
+    // Commands that cannot touch it are never drawn and have an empty box that overlaps nothing.
+    for (size_t i = 0; i < cl->count; ++i) {
+        int *box = &cl->boxes[i*4];
+        Olivec_Command c;
+        olivec_cmd_get(cl, i, &c);
+        if (!olivec_cmd_bounds(cl, &c, INT32_MAX, INT32_MAX, &box[0], &box[1], &box[2], &box[3])) {
+            box[0] = box[1] = 0;
+            box[2] = box[3] = -1;
+        }
+    }
+
+    // Insertion sort that moves every command back to right after the last command with the same state,
+    // but never past a command it overlaps with.
+    for (size_t i = 1; i < cl->count; ++i) {
+        Olivec_Command ci;
+        olivec_cmd_get(cl, i, &ci);
+        size_t lo = i > OLIVEC_CMD_SORT_WINDOW ? i - OLIVEC_CMD_SORT_WINDOW : 0;
+        size_t target = i;
+        for (size_t j = i; j-- > lo;) {
+            Olivec_Command cj;
+            olivec_cmd_get(cl, j, &cj);
+            if (olivec_cmd_same_state(&ci, &cj)) {
+                target = j + 1;
+                break;
+            }
+            if (olivec_boxes_overlap(&cl->boxes[i*4], &cl->boxes[j*4])) break;
+        }
+        if (target == i) continue;
+
+        uint32_t offset = cl->order[i];
+        int box[4];
+        memcpy(box, &cl->boxes[i*4], sizeof(box));
+        memmove(&cl->order[target + 1], &cl->order[target], (i - target)*sizeof(*cl->order));
+        memmove(&cl->boxes[(target + 1)*4], &cl->boxes[target*4], (i - target)*4*sizeof(*cl->boxes));
+        cl->order[target] = offset;
+        memcpy(&cl->boxes[target*4], box, sizeof(box));
+    }
+}
+
+OLIVECDEF void olivec_cmd_merge_rects(Olivec_CommandList *cl)
+{
+    if (cl->count == 0) return;
+
+    size_t count = 1;
+    Olivec_Command last;
+    olivec_cmd_get(cl, 0, &last);
+    for (size_t i = 1; i < cl->count; ++i) {
+        Olivec_Command c;
+        olivec_cmd_get(cl, i, &c);
+        cl->order[count] = cl->order[i];
+
+        Olivec_Normalized_Rect a, b;
+        if (last.kind == OLIVEC_CMD_RECT && c.kind == OLIVEC_CMD_RECT && olivec_cmd_same_state(&last, &c) &&
+            olivec_normalize_rect(last.rect.x, last.rect.y, last.rect.w, last.rect.h, INT32_MAX, INT32_MAX, &a) &&
+            olivec_normalize_rect(c.rect.x, c.rect.y, c.rect.w, c.rect.h, INT32_MAX, INT32_MAX, &b)) {
+            // The rects do not overlap, so blending them separately or as one is the same thing
+            bool horizontal = a.oy1 == b.oy1 && a.oy2 == b.oy2 && (a.ox2 + 1 == b.ox1 || b.ox2 + 1 == a.ox1);
+            bool vertical = a.ox1 == b.ox1 && a.ox2 == b.ox2 && (a.oy2 + 1 == b.oy1 || b.oy2 + 1 == a.oy1);
+            if (horizontal || vertical) {
+                int x1 = a.ox1 < b.ox1 ? a.ox1 : b.ox1;
+                int y1 = a.oy1 < b.oy1 ? a.oy1 : b.oy1;
+                int x2 = a.ox2 > b.ox2 ? a.ox2 : b.ox2;
+                int y2 = a.oy2 > b.oy2 ? a.oy2 : b.oy2;
+                last.rect.x = x1;
+                last.rect.y = y1;
+                last.rect.w = x2 - x1 + 1;
+                last.rect.h = y2 - y1 + 1;
+                olivec_cmd_set(cl, count - 1, &last);
+                continue;
+            }
+        }
+
+        last = c;
+        count += 1;
+    }
+    cl->count = count;
+}
+
+// Tiles
+
+static void olivec_tiler_tile(void *user, size_t index)
+{
+    Olivec_Tiler *tiler = user;
+    int tx = (int) (index%tiler->tiles_x)*OLIVEC_TILE_SIZE;
+    int ty = (int) (index/tiler->tiles_x)*OLIVEC_TILE_SIZE;
+    Olivec_Canvas tile = olivec_subcanvas(tiler->oc, tx, ty, OLIVEC_TILE_SIZE, OLIVEC_TILE_SIZE);
+    for (uint32_t i = tiler->start[index]; i < tiler->start[index + 1]; ++i) {
+        Olivec_Command c;
+        olivec_cmd_get(tiler->cl, tiler->items[i], &c);
+        olivec_cmd_execute(tiler->cl, &c, tile, -tx, -ty);
+    }
+}
+
+OLIVECDEF void olivec_tiler_render(Olivec_Tiler *tiler, Olivec_Canvas oc, const Olivec_CommandList *cl)
+{
+    if (oc.width == 0 || oc.height == 0) return;
+
+    size_t tiles_x = (oc.width + OLIVEC_TILE_SIZE - 1)/OLIVEC_TILE_SIZE;
+    size_t tiles_y = (oc.height + OLIVEC_TILE_SIZE - 1)/OLIVEC_TILE_SIZE;
+    size_t tiles = tiles_x*tiles_y;
+    if (!olivec_reserve((void**) &tiler->start, &tiler->start_capacity, tiles + 1, sizeof(*tiler->start))) return;
+    if (!olivec_reserve((void**) &tiler->ranges, &tiler->ranges_capacity, cl->count*4, sizeof(*tiler->ranges))) return;
+
+    // Count the commands of every tile into start[tile + 1]
+    memset(tiler->start, 0, (tiles + 1)*sizeof(*tiler->start));
+    for (size_t i = 0; i < cl->count; ++i) {
+        int *r = &tiler->ranges[i*4];
+        int x1, y1, x2, y2;
+        Olivec_Command c;
+        olivec_cmd_get(cl, i, &c);
+        if (!olivec_cmd_bounds(cl, &c, oc.width, oc.height, &x1, &y1, &x2, &y2)) {
+            r[0] = 0; r[1] = 0; r[2] = -1; r[3] = -1;
+            continue;
+        }
+        r[0] = x1/OLIVEC_TILE_SIZE;
+        r[1] = y1/OLIVEC_TILE_SIZE;
+        r[2] = x2/OLIVEC_TILE_SIZE;
+        r[3] = y2/OLIVEC_TILE_SIZE;
+        for (int ty = r[1]; ty <= r[3]; ++ty) {
+            for (int tx = r[0]; tx <= r[2]; ++tx) {
+                tiler->start[ty*tiles_x + tx + 1] += 1;
+            }
+        }
+    }
+    for (size_t i = 0; i < tiles; ++i) tiler->start[i + 1] += tiler->start[i];
+
+    // Scatter the command indices in order. That advances every start[tile] to the end of its tile,
+    // which is fixed up by shifting the array back afterwards.
+    if (!olivec_reserve((void**) &tiler->items, &tiler->items_capacity, tiler->start[tiles], sizeof(*tiler->items))) return;
+    for (size_t i = 0; i < cl->count; ++i) {
+        int *r = &tiler->ranges[i*4];
+        for (int ty = r[1]; ty <= r[3]; ++ty) {
+            for (int tx = r[0]; tx <= r[2]; ++tx) {
+                tiler->items[tiler->start[ty*tiles_x + tx]++] = (uint32_t) i;
+            }
+        }
+    }
+    for (size_t i = tiles; i > 0; --i) tiler->start[i] = tiler->start[i - 1];
+    tiler->start[0] = 0;
+
+    tiler->oc = oc;
+    tiler->cl = cl;
+    tiler->tiles_x = tiles_x;
+    tiler->tiles_y = tiles_y;
+    olivec_pool_run(tiles, olivec_tiler_tile, tiler);
+}
+
+OLIVECDEF void olivec_tiler_free(Olivec_Tiler *tiler)
+{
+    OLIVEC_FREE(tiler->start);
+    OLIVEC_FREE(tiler->items);
+    OLIVEC_FREE(tiler->ranges);
+    *tiler = (Olivec_Tiler) {0};
 }
 
 #endif // OLIVEC_IMPLEMENTATION
 
 // TODO: Benchmarking
-// TODO: SIMD implementations
 // TODO: bezier curves
 // TODO: olivec_ring
 // TODO: fuzzer